@@ -0,0 +1,706 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <gmp.h>
+
+#include "common.h"
+#include "util.h"
+#include "io.h"
+#include "block.h"
+#include "statistics.h"
+#include "source.h"
+#include "splitter.h"
+#include "numeration.h"
+#include "serializer.h"
+#include "encryption.h"
+
+#define EE_BENCH_BYTES_DEFAULT (256 * 1024)
+#define EE_BENCH_SIGMA_MIN 1
+#define EE_BENCH_SIGMA_MAX 16
+#define EE_BENCH_MU_MIN 0
+#define EE_BENCH_MU_MAX 8
+#define EE_BENCH_ALL -1
+
+#define EE_BENCH_FILE "ee_bench.tmp"
+#define EE_BENCH_BITS_FILE "ee_bench_bits.tmp"
+#define EE_BENCH_BITS_SHIFT 3
+#define EE_BENCH_KEY "ee_bench"
+#define EE_BENCH_SEED 0x9e3779b97f4a7c15ULL
+
+#define EE_BENCH_NS_IN_S 1000000000.0
+#define EE_BENCH_BYTES_IN_MB (1024.0 * 1024.0)
+
+#define EE_GOTO_IF_NOT_SUCCESS(status, label) \
+        if (EE_SUCCESS != (status)) { \
+            goto label; \
+        }
+
+#define EE_BENCH_START(bench) \
+        do { \
+            (bench)->start = ee_bench_now_s(); \
+        } while (0)
+
+#define EE_BENCH_STOP(bench, stage) \
+        do { \
+            (bench)->ns[(stage)] += ee_bench_now_s() - (bench)->start; \
+        } while (0)
+
+enum {
+    EE_STAGE_READ_MESSAGE,
+    EE_STAGE_SOURCE_SPLIT,
+    EE_STAGE_STATISTICS_GATHER,
+    EE_STAGE_NUMBER_EVAL,
+    EE_STAGE_SUBNUMBER_EVAL,
+    EE_STAGE_SERIALIZE,
+    EE_STAGE_KEYSTREAM_XOR,
+    EE_STAGE_DESERIALIZE,
+    EE_STAGE_RHO_DELTA_EVAL,
+    EE_STAGE_NUMBER_RESTORE,
+    EE_STAGE_BLOCK_RESTORE,
+    EE_STAGE_SOURCE_MERGE,
+    EE_STAGE_WRITE_BITS,
+    EE_STAGE_READ_BITS,
+    EE_STAGES_NUMBER
+};
+
+enum {
+    EE_INPUT_UNIFORM,
+    EE_INPUT_SKEWED,
+    EE_INPUT_TEXT,
+    EE_INPUT_SAME,
+    EE_INPUTS_NUMBER
+};
+
+typedef struct ee_bench_s {
+    uint64_t start;
+    uint64_t ns[EE_STAGES_NUMBER];
+    ee_size_t sigma;
+    ee_int_t format;
+    uint64_t header_bits;
+    uint64_t subnum_bits;
+    ee_numeration_ctx_t nctx;
+    ee_serializer_ctx_t sctx;
+    ee_key_t enc_key;
+    ee_key_t dec_key;
+    ee_block_t block;
+    ee_block_t restored;
+    ee_number_t number;
+    ee_number_t restored_number;
+    ee_subnumber_t subnumber;
+    ee_subnumber_t restored_subnumber;
+    ee_statistics_t statistics;
+    ee_statistics_t restored_statistics;
+    ee_sdata_t statistics_data;
+    ee_sdata_t subset_data;
+    ee_sdata_t subnum_data;
+    mpz_t rho;
+    mpz_t delta;
+    ee_int_t status;
+} ee_bench_t;
+
+static const char *ee_stage_names_s[EE_STAGES_NUMBER] = {
+    "read_message",
+    "source_split",
+    "statistics_gather",
+    "number_eval",
+    "subnumber_eval",
+    "serialize",
+    "keystream_xor",
+    "deserialize",
+    "rho_delta_eval",
+    "number_restore",
+    "block_restore",
+    "source_merge",
+    "write_bits",
+    "read_bits"
+};
+
+static const char *ee_input_names_s[EE_INPUTS_NUMBER] = {
+    "uniform",
+    "skewed",
+    "text",
+    "same"
+};
+
+static const char *ee_text_words_s[] = {
+    "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as",
+    "was", "with", "be", "by", "on", "not", "he", "this", "are", "or", "his",
+    "from", "at", "which", "but", "have", "an", "had", "they", "you", "were",
+    "their", "one", "all", "we", "can", "her", "has", "there", "been", "if",
+    "more", "when", "will", "would", "who", "so", "no", "block", "source",
+    "number", "message", "statistics"
+};
+
+static uint64_t
+ee_bench_now_s(void);
+static uint64_t
+ee_bench_rand_s(uint64_t *state);
+static void
+ee_bench_generate_s(ee_message_t *message, ee_int_t input);
+
+static ee_int_t
+ee_bench_run_s(ee_size_t length, ee_size_t sigma, ee_size_t mu,
+        ee_int_t input, ee_int_t format, ee_bool_t first);
+static ee_bool_t
+ee_bench_source_handler_s(ee_source_t *source, void *context);
+static ee_int_t
+ee_bench_block_s(ee_bench_t *bench);
+static ee_int_t
+ee_bench_bits_s(ee_bench_t *bench, ee_message_t *message);
+static void
+ee_bench_print_s(ee_bench_t *bench, ee_size_t length, ee_size_t mu,
+        ee_int_t input, ee_bool_t first);
+
+static void
+ee_print_help_msg_s(const char *pname);
+
+int
+main(int argc, char *argv[])
+{
+    static const char *opts = "n:s:u:i:ch";
+    static const struct option lopts[] = {
+        { "bytes", required_argument, NULL, 'n' },
+        { "sigma", required_argument, NULL, 's' },
+        { "mu",    required_argument, NULL, 'u' },
+        { "input", required_argument, NULL, 'i' },
+        { "compact", no_argument,     NULL, 'c' },
+        { "help",  no_argument,       NULL, 'h' },
+        { NULL,    0,                 NULL, 0   }
+    };
+
+    ee_int_t status = EE_SUCCESS;
+    ee_size_t length = EE_BENCH_BYTES_DEFAULT;
+    ee_int_t sigma = EE_BENCH_ALL;
+    ee_int_t mu = EE_BENCH_ALL;
+    ee_int_t input = EE_BENCH_ALL;
+    ee_int_t format = EE_STATISTICS_FORMAT_PLAIN;
+    ee_bool_t first = EE_TRUE;
+
+    int c;
+    while (-1 != (c = getopt_long(argc, argv, opts, lopts, NULL))) {
+        switch (c) {
+        case 'n':
+            length = strtoul(optarg, NULL, 10);
+            if (0 == length) {
+                fprintf(stderr, "%s: '--bytes' must be a positive integer\n",
+                        argv[0]);
+                return EE_FAILURE;
+            }
+
+            break;
+        case 's':
+            sigma = atoi(optarg);
+            if (EE_BENCH_SIGMA_MIN > sigma || EE_BENCH_SIGMA_MAX < sigma) {
+                fprintf(stderr, "%s: '--sigma' must be in range [%d; %d]\n",
+                        argv[0], EE_BENCH_SIGMA_MIN, EE_BENCH_SIGMA_MAX);
+                return EE_FAILURE;
+            }
+
+            break;
+        case 'u':
+            mu = atoi(optarg);
+            if (EE_BENCH_MU_MIN > mu || EE_BENCH_MU_MAX < mu) {
+                fprintf(stderr, "%s: '--mu' must be in range [%d; %d]\n",
+                        argv[0], EE_BENCH_MU_MIN, EE_BENCH_MU_MAX);
+                return EE_FAILURE;
+            }
+
+            break;
+        case 'i':
+            for (input = 0; input < EE_INPUTS_NUMBER; ++input) {
+                if (0 == strcmp(optarg, ee_input_names_s[input])) {
+                    break;
+                }
+            }
+
+            if (EE_INPUTS_NUMBER == input) {
+                fprintf(stderr, "%s: '--input' must be 'uniform', 'skewed', "
+                        "'text' or 'same'\n", argv[0]);
+                return EE_FAILURE;
+            }
+
+            break;
+        case 'c':
+            format = EE_STATISTICS_FORMAT_COMPACT;
+            break;
+        case 'h':
+            ee_print_help_msg_s(argv[0]);
+            return EE_SUCCESS;
+        default:
+            return EE_FAILURE;
+        }
+    }
+
+    printf("[\n");
+    for (ee_int_t i = 0; i < EE_INPUTS_NUMBER; ++i) {
+        if (EE_BENCH_ALL != input && input != i) {
+            continue;
+        }
+
+        for (ee_int_t u = EE_BENCH_MU_MIN; u <= EE_BENCH_MU_MAX; ++u) {
+            if (EE_BENCH_ALL != mu && mu != u) {
+                continue;
+            }
+
+            for (ee_int_t s = EE_BENCH_SIGMA_MIN; s <= EE_BENCH_SIGMA_MAX;
+                    ++s) {
+                if (EE_BENCH_ALL != sigma && sigma != s) {
+                    continue;
+                }
+
+                status = ee_bench_run_s(length, s, u, i, format, first);
+                if (EE_SUCCESS != status) {
+                    fprintf(stderr, "%s: sigma %ld, mu %ld, input '%s' "
+                            "failed with code %ld\n", argv[0], s, u,
+                            ee_input_names_s[i], status);
+                    goto end;
+                }
+
+                first = EE_FALSE;
+            }
+        }
+    }
+
+end:
+    printf("\n]\n");
+    remove(EE_BENCH_FILE);
+    remove(EE_BENCH_BITS_FILE);
+
+    return status;
+}
+
+static uint64_t
+ee_bench_now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+ee_bench_rand_s(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static void
+ee_bench_generate_s(ee_message_t *message, ee_int_t input)
+{
+    static const ee_size_t words_number =
+            sizeof(ee_text_words_s) / sizeof(*ee_text_words_s);
+
+    uint64_t state = EE_BENCH_SEED;
+    ee_size_t i = 0;
+    ee_size_t line = 0;
+
+    while (i < message->length) {
+        uint64_t r = ee_bench_rand_s(&state);
+        switch (input) {
+        case EE_INPUT_UNIFORM:
+            message->chars[i++] = (ee_char_t)(r & 0xff);
+            break;
+        case EE_INPUT_SKEWED:
+            /* Geometric: every next symbol is half as likely. */
+            message->chars[i] = 0;
+            while (0 != (r & 0x01) && 0xff != message->chars[i]) {
+                message->chars[i] += 1;
+                r >>= 1;
+            }
+
+            i += 1;
+            break;
+        case EE_INPUT_TEXT: {
+            const char *word = ee_text_words_s[r % words_number];
+            for (; '\0' != *word && i < message->length; ++word, ++line) {
+                message->chars[i++] = *word;
+            }
+
+            if (i < message->length) {
+                message->chars[i++] = (line > 72) ? '\n' : ' ';
+                line = (line > 72) ? 0 : line + 1;
+            }
+
+            break;
+        }
+        default:
+            message->chars[i++] = 'a';
+            break;
+        }
+    }
+}
+
+static ee_int_t
+ee_bench_run_s(ee_size_t length, ee_size_t sigma, ee_size_t mu,
+        ee_int_t input, ee_int_t format, ee_bool_t first)
+{
+    ee_int_t status;
+
+    ee_bench_t bench;
+    ee_file_t file;
+    ee_message_t message;
+    ee_message_t merged;
+    ee_source_list_t sources;
+
+    ee_memset(&bench, 0, sizeof(bench));
+    bench.sigma = sigma;
+    bench.format = format;
+    bench.status = EE_SUCCESS;
+
+    status = ee_message_init(&message, length);
+    EE_GOTO_IF_NOT_SUCCESS(status, message_init_error);
+    ee_bench_generate_s(&message, input);
+    status = ee_file_open(&file, EE_BENCH_FILE, EE_MODE_WRITE);
+    if (EE_SUCCESS == status) {
+        status = ee_file_write_message(&file, &message);
+        ee_file_close(&file);
+    }
+
+    ee_message_deinit(&message);
+    EE_GOTO_IF_NOT_SUCCESS(status, message_init_error);
+
+    status = ee_file_open(&file, EE_BENCH_FILE, EE_MODE_READ);
+    EE_GOTO_IF_NOT_SUCCESS(status, message_init_error);
+    EE_BENCH_START(&bench);
+    status = ee_file_read_message(&message, &file);
+    EE_BENCH_STOP(&bench, EE_STAGE_READ_MESSAGE);
+    ee_file_close(&file);
+    EE_GOTO_IF_NOT_SUCCESS(status, message_read_error);
+
+    ee_source_list_init(&sources, mu);
+    EE_BENCH_START(&bench);
+    status = ee_source_split(&sources, &message);
+    EE_BENCH_STOP(&bench, EE_STAGE_SOURCE_SPLIT);
+    EE_GOTO_IF_NOT_SUCCESS(status, source_split_error);
+
+    status = ee_numeration_ctx_init(&(bench.nctx), sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, nctx_init_error);
+    status = ee_block_init(&(bench.block), sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, block_init_error);
+    status = ee_block_init(&(bench.restored), sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, restored_init_error);
+    status = ee_key_init(&(bench.enc_key), EE_BENCH_KEY);
+    EE_GOTO_IF_NOT_SUCCESS(status, enc_key_init_error);
+    status = ee_key_init(&(bench.dec_key), EE_BENCH_KEY);
+    EE_GOTO_IF_NOT_SUCCESS(status, dec_key_init_error);
+
+    ee_number_init(&(bench.number));
+    ee_number_init(&(bench.restored_number));
+    ee_subnumber_init(&(bench.subnumber));
+    ee_subnumber_init(&(bench.restored_subnumber));
+    mpz_init(bench.rho);
+    mpz_init(bench.delta);
+    ee_serializer_ctx_init(&(bench.sctx));
+
+    ee_source_list_traverse(&sources, ee_bench_source_handler_s, &bench);
+    status = bench.status;
+    EE_GOTO_IF_NOT_SUCCESS(status, blocks_error);
+
+    status = ee_message_init(&merged, message.length);
+    EE_GOTO_IF_NOT_SUCCESS(status, blocks_error);
+    EE_BENCH_START(&bench);
+    status = ee_source_merge(&merged, &sources);
+    EE_BENCH_STOP(&bench, EE_STAGE_SOURCE_MERGE);
+    if (EE_SUCCESS == status
+            && 0 != memcmp(merged.chars, message.chars, message.length)) {
+        status = EE_FAILURE;
+    }
+
+    ee_message_deinit(&merged);
+    EE_GOTO_IF_NOT_SUCCESS(status, blocks_error);
+    status = ee_bench_bits_s(&bench, &message);
+    EE_GOTO_IF_NOT_SUCCESS(status, blocks_error);
+
+    ee_bench_print_s(&bench, message.length, mu, input, first);
+
+blocks_error:
+    ee_sdata_clear(&(bench.subnum_data));
+    ee_sdata_clear(&(bench.subset_data));
+    ee_sdata_clear(&(bench.statistics_data));
+    ee_serializer_ctx_deinit(&(bench.sctx));
+    mpz_clear(bench.delta);
+    mpz_clear(bench.rho);
+    ee_subnumber_deinit(&(bench.restored_subnumber));
+    ee_subnumber_deinit(&(bench.subnumber));
+    ee_number_deinit(&(bench.restored_number));
+    ee_number_deinit(&(bench.number));
+    ee_key_deinit(&(bench.dec_key));
+dec_key_init_error:
+    ee_key_deinit(&(bench.enc_key));
+enc_key_init_error:
+    ee_block_deinit(&(bench.restored));
+restored_init_error:
+    ee_block_deinit(&(bench.block));
+block_init_error:
+    ee_numeration_ctx_deinit(&(bench.nctx));
+nctx_init_error:
+source_split_error:
+    ee_source_list_deinit(&sources);
+    ee_message_deinit(&message);
+message_read_error:
+message_init_error:
+    return status;
+}
+
+static ee_bool_t
+ee_bench_source_handler_s(ee_source_t *source, void *context)
+{
+    ee_bench_t *bench = context;
+    ee_int_t block_status;
+    ee_size_t offset = 0;
+
+    do {
+        block_status = ee_block_from_source(&(bench->block), source, offset);
+        if (0 == bench->block.length) {
+            break;
+        }
+
+        offset += bench->block.length;
+        bench->status = ee_bench_block_s(bench);
+        if (EE_SUCCESS != bench->status) {
+            return EE_FALSE;
+        }
+    } while (EE_FINAL_BLOCK != block_status);
+
+    return EE_TRUE;
+}
+
+/*
+ * Runs one block through every per-block stage of encryption and then of
+ * decryption, the same way src/crypt.c does, and checks that it comes back.
+ */
+static ee_int_t
+ee_bench_block_s(ee_bench_t *bench)
+{
+    ee_int_t status;
+
+    ee_block_t *block = &(bench->block);
+    ee_block_t *restored = &(bench->restored);
+    ee_subnumber_t *subnumber = &(bench->restored_subnumber);
+
+    EE_BENCH_START(bench);
+    ee_statistics_gather(&(bench->statistics), block);
+    EE_BENCH_STOP(bench, EE_STAGE_STATISTICS_GATHER);
+
+    EE_BENCH_START(bench);
+    ee_number_eval(&(bench->nctx), &(bench->number), block,
+            &(bench->statistics));
+    EE_BENCH_STOP(bench, EE_STAGE_NUMBER_EVAL);
+
+    EE_BENCH_START(bench);
+    ee_subnumber_eval(&(bench->nctx), &(bench->subnumber), &(bench->number));
+    EE_BENCH_STOP(bench, EE_STAGE_SUBNUMBER_EVAL);
+
+    EE_BENCH_START(bench);
+    status = ee_mpz_serialize(&(bench->subnum_data), bench->subnumber.subnum,
+            bench->subnumber.subnum_bit_length);
+    if (EE_SUCCESS == status) {
+        status = ee_statistics_serialize(&(bench->sctx),
+                &(bench->statistics_data), &(bench->statistics), bench->sigma,
+                bench->format);
+    }
+
+    if (EE_SUCCESS == status) {
+        status = ee_subset_serialize(&(bench->subset_data),
+                bench->subnumber.subset, bench->sigma);
+    }
+
+    EE_BENCH_STOP(bench, EE_STAGE_SERIALIZE);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    bench->header_bits += bench->statistics_data.bits_number
+            + bench->subset_data.bits_number;
+    bench->subnum_bits += bench->subnum_data.bits_number;
+
+    EE_BENCH_START(bench);
+    ee_sdata_encrypt(&(bench->subnum_data), &(bench->enc_key));
+    ee_sdata_decrypt(&(bench->subnum_data), &(bench->dec_key));
+    EE_BENCH_STOP(bench, EE_STAGE_KEYSTREAM_XOR);
+
+    EE_BENCH_START(bench);
+    ee_statistics_deserialize(&(bench->sctx), &(bench->restored_statistics),
+            &(bench->statistics_data), bench->sigma);
+    ee_subset_deserialize(&(subnumber->subset), &(bench->subset_data));
+    EE_BENCH_STOP(bench, EE_STAGE_DESERIALIZE);
+
+    EE_BENCH_START(bench);
+    ee_block_generate(restored, &(bench->restored_statistics));
+    ee_eval_rho_delta(&(bench->nctx), bench->rho, bench->delta, restored,
+            &(bench->restored_statistics));
+    EE_BENCH_STOP(bench, EE_STAGE_RHO_DELTA_EVAL);
+
+    EE_BENCH_START(bench);
+    ee_eval_subnum_bit_length(&(subnumber->subnum_bit_length), bench->delta,
+            subnumber->subset);
+    ee_mpz_deserialize(subnumber->subnum, subnumber->subnum_bit_length,
+            &(bench->subnum_data));
+    EE_BENCH_STOP(bench, EE_STAGE_DESERIALIZE);
+
+    EE_BENCH_START(bench);
+    ee_number_restore(&(bench->nctx), &(bench->restored_number), bench->delta,
+            subnumber);
+    EE_BENCH_STOP(bench, EE_STAGE_NUMBER_RESTORE);
+
+    EE_BENCH_START(bench);
+    ee_block_restore(&(bench->nctx), restored, &(bench->restored_statistics),
+            bench->rho, &(bench->restored_number));
+    EE_BENCH_STOP(bench, EE_STAGE_BLOCK_RESTORE);
+
+    if (restored->length != block->length
+            || 0 != memcmp(restored->chars, block->chars, block->length)) {
+        return EE_FAILURE;
+    }
+
+    return EE_SUCCESS;
+}
+
+/*
+ * Writes the message to a file in block-sized pieces after a few odd bits, so
+ * every piece takes the unaligned path of ee_file_write_bits(), then reads it
+ * back the same way through ee_file_read_bits() and checks it.
+ */
+static ee_int_t
+ee_bench_bits_s(ee_bench_t *bench, ee_message_t *message)
+{
+    ee_int_t status;
+
+    ee_file_t file;
+    ee_message_t restored;
+    ee_byte_t shift;
+    ee_size_t piece = bench->block.size;
+
+    status = ee_message_init(&restored, message->length);
+    EE_GOTO_IF_NOT_SUCCESS(status, message_init_error);
+    status = ee_file_open(&file, EE_BENCH_BITS_FILE, EE_MODE_WRITE);
+    EE_GOTO_IF_NOT_SUCCESS(status, file_open_error);
+
+    EE_BENCH_START(bench);
+    status = ee_file_write_byte_bits(&file, 0, EE_BENCH_BITS_SHIFT);
+    for (ee_size_t offset = 0;
+            EE_SUCCESS == status && offset < message->length;
+            offset += piece) {
+        ee_size_t number = message->length - offset;
+        if (number > piece) {
+            number = piece;
+        }
+
+        status = ee_file_write_bits(&file, message->chars + offset,
+                number * EE_BITS_IN_BYTE);
+    }
+
+    if (EE_SUCCESS == status) {
+        status = ee_file_flush(&file);
+    }
+
+    EE_BENCH_STOP(bench, EE_STAGE_WRITE_BITS);
+    ee_file_close(&file);
+    EE_GOTO_IF_NOT_SUCCESS(status, file_open_error);
+
+    status = ee_file_open(&file, EE_BENCH_BITS_FILE, EE_MODE_READ);
+    EE_GOTO_IF_NOT_SUCCESS(status, file_open_error);
+
+    EE_BENCH_START(bench);
+    status = ee_file_read_byte_bits(&shift, EE_BENCH_BITS_SHIFT, &file);
+    for (ee_size_t offset = 0;
+            EE_SUCCESS == status && offset < message->length;
+            offset += piece) {
+        ee_size_t number = message->length - offset;
+        if (number > piece) {
+            number = piece;
+        }
+
+        status = ee_file_read_bits(restored.chars + offset,
+                number * EE_BITS_IN_BYTE, &file);
+    }
+
+    EE_BENCH_STOP(bench, EE_STAGE_READ_BITS);
+    ee_file_close(&file);
+
+    if (EE_SUCCESS == status
+            && 0 != memcmp(restored.chars, message->chars, message->length)) {
+        status = EE_FAILURE;
+    }
+
+file_open_error:
+    ee_message_deinit(&restored);
+message_init_error:
+    return status;
+}
+
+static void
+ee_bench_print_s(ee_bench_t *bench, ee_size_t length, ee_size_t mu,
+        ee_int_t input, ee_bool_t first)
+{
+    uint64_t total = 0;
+
+    printf("%s  {\n", (EE_TRUE == first) ? "" : ",\n");
+    printf("    \"sigma\": %lu,\n", (unsigned long)bench->sigma);
+    printf("    \"mu\": %lu,\n", (unsigned long)mu);
+    printf("    \"input\": \"%s\",\n", ee_input_names_s[input]);
+    printf("    \"format\": \"%s\",\n",
+            (EE_STATISTICS_FORMAT_COMPACT == bench->format)
+                    ? "compact" : "plain");
+    printf("    \"bytes\": %lu,\n", (unsigned long)length);
+    printf("    \"header_bytes\": %llu,\n",
+            (unsigned long long)EE_EVAL_BYTES_NUMBER(bench->header_bits));
+    printf("    \"subnum_bytes\": %llu,\n",
+            (unsigned long long)EE_EVAL_BYTES_NUMBER(bench->subnum_bits));
+    printf("    \"stages\": {\n");
+    for (ee_size_t i = 0; i < EE_STAGES_NUMBER; ++i) {
+        double ns = (double)bench->ns[i];
+        /* The bit I/O stages time the file layer alone, not the pipeline. */
+        if (i < EE_STAGE_WRITE_BITS) {
+            total += bench->ns[i];
+        }
+
+        printf("      \"%s\": { \"ns_per_byte\": %.3f, \"mb_per_s\": %.3f }%s\n",
+                ee_stage_names_s[i], ns / length,
+                (0 == bench->ns[i]) ? 0.0
+                        : length / EE_BENCH_BYTES_IN_MB
+                                / (ns / EE_BENCH_NS_IN_S),
+                (i + 1 < EE_STAGES_NUMBER) ? "," : "");
+    }
+
+    printf("    },\n");
+    printf("    \"total\": { \"ns_per_byte\": %.3f, \"mb_per_s\": %.3f }\n",
+            (double)total / length,
+            length / EE_BENCH_BYTES_IN_MB / ((double)total / EE_BENCH_NS_IN_S));
+    printf("  }");
+    fflush(stdout);
+}
+
+static void
+ee_print_help_msg_s(const char *pname)
+{
+    printf("Usage: %s [options]\n\n", pname);
+    printf("Times every stage of encryption and decryption over a matrix of\n"
+            "sigma, mu and synthetic inputs and prints the results as JSON.\n\n"
+            "where possible options include:\n");
+    printf("\t-n, --bytes=[VALUE]  \tsize of the synthetic message in bytes;\n"
+            "\t                     \t'%d' by default\n",
+            EE_BENCH_BYTES_DEFAULT);
+    printf("\t-s, --sigma=[VALUE]  \tonly runs this sigma; all of [%d; %d] "
+            "by default\n", EE_BENCH_SIGMA_MIN, EE_BENCH_SIGMA_MAX);
+    printf("\t-u, --mu=[VALUE]     \tonly runs this mu; all of [%d; %d] "
+            "by default\n", EE_BENCH_MU_MIN, EE_BENCH_MU_MAX);
+    printf("\t-i, --input=[VALUE]  \tonly runs this input: 'uniform', "
+            "'skewed', 'text'\n"
+            "\t                     \tor 'same'; all of them by default\n");
+    printf("\t-c, --compact        \tserializes statistics in the compact "
+            "format;\n"
+            "\t                     \tthe plain one by default\n");
+    printf("\t-h, --help           \tprints this message\n");
+}
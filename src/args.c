@@ -23,6 +23,15 @@
 #define EE_MU_MIN 0
 #define EE_MU_MAX 255
 
+#define EE_THREADS_DEFAULT 1
+#define EE_THREADS_MIN 1
+#define EE_THREADS_MAX 256
+
+#define EE_WINDOW_DEFAULT 0
+#define EE_WINDOW_MIN 0
+#define EE_WINDOW_MAX 4095
+#define EE_WINDOW_UNIT (1024 * 1024)
+
 #define EE_OUTPUT_FILE_DEFAULT "a.out"
 #define EE_OUTPUT_FILE_DEFAULT_STR EE_OUTPUT_FILE_DEFAULT
 
@@ -63,13 +72,17 @@ ee_print_help_msg_s(void);
 ee_int_t
 ee_args_parse(ee_args_t *args, int argc, char *argv[])
 {
-    static const char *opts = "m:s:u:dpo:k:h";
+    static const char *opts = "m:s:u:t:w:dpco:k:h";
     static const struct option lopts[] = {
         { "mode",         required_argument, NULL, 'm' },
         { "sigma",        required_argument, NULL, 's' },
         { "mu",           required_argument, NULL, 'u' },
+        { "threads",      required_argument, NULL, 't' },
+        { "window",       required_argument, NULL, 'w' },
         { "dump-sources", no_argument,       NULL, 'd' },
         { "part",         no_argument,       NULL, 'p' },
+        { "compact",      no_argument,       NULL, 'c' },
+        { "stats",        optional_argument, NULL, 'S' },
         { "output",       required_argument, NULL, 'o' },
         { "key",          required_argument, NULL, 'k' },
         { "help",         no_argument,       NULL, 'h' },
@@ -82,13 +95,19 @@ ee_args_parse(ee_args_t *args, int argc, char *argv[])
     ee_bool_t sigma_specified = EE_FALSE;
     ee_bool_t mu_specified = EE_FALSE;
     ee_bool_t dump_sources_specified = EE_FALSE;
+    ee_bool_t compact_specified = EE_FALSE;
     ee_bool_t output_specified = EE_FALSE;
 
     args->mode = EE_MODE_DEFAULT;
     args->sigma = EE_SIGMA_DEFAULT;
     args->mu = EE_MU_DEFAULT;
+    args->threads = EE_THREADS_DEFAULT;
+    args->window = EE_WINDOW_DEFAULT;
     args->dump_sources = EE_FALSE;
     args->part = EE_FALSE;
+    args->compact = EE_FALSE;
+    args->stats = EE_FALSE;
+    args->stats_json = EE_FALSE;
     args->key = NULL;
     args->input_file = NULL;
     args->output_file = EE_OUTPUT_FILE_DEFAULT;
@@ -156,6 +175,48 @@ ee_args_parse(ee_args_t *args, int argc, char *argv[])
 
             mu_specified = EE_TRUE;
             break;
+        case 't':
+            EE_CHECK_OPTARG(argv[0], "'--threads'", status, end);
+            args->threads = atoi(optarg);
+            if (0 == args->threads && '0' != optarg[0]) {
+                fprintf(stderr, "%s: '--threads' must be an integer value\n",
+                        argv[0]);
+                EE_SEE_HELP(argv[0]);
+                status = EE_FAILURE;
+                goto end;
+            }
+
+            if (EE_THREADS_MIN > args->threads
+                    || EE_THREADS_MAX < args->threads) {
+                fprintf(stderr, "%s: '--threads' must be in range [%d; %d]\n",
+                        argv[0], EE_THREADS_MIN, EE_THREADS_MAX);
+                EE_SEE_HELP(argv[0]);
+                status = EE_FAILURE;
+                goto end;
+            }
+
+            break;
+        case 'w':
+            EE_CHECK_OPTARG(argv[0], "'--window'", status, end);
+            args->window = atoi(optarg);
+            if (0 == args->window && '0' != optarg[0]) {
+                fprintf(stderr, "%s: '--window' must be an integer value\n",
+                        argv[0]);
+                EE_SEE_HELP(argv[0]);
+                status = EE_FAILURE;
+                goto end;
+            }
+
+            if (EE_WINDOW_MIN > args->window || EE_WINDOW_MAX < args->window) {
+                fprintf(stderr, "%s: '--window' must be in range [%d; %d]\n",
+                        argv[0], EE_WINDOW_MIN, EE_WINDOW_MAX);
+                EE_SEE_HELP(argv[0]);
+                status = EE_FAILURE;
+                goto end;
+            }
+
+            args->window *= EE_WINDOW_UNIT;
+            break;
         case 'd':
             args->dump_sources = EE_TRUE;
             dump_sources_specified = EE_TRUE;
@@ -163,6 +224,26 @@ ee_args_parse(ee_args_t *args, int argc, char *argv[])
         case 'p':
             args->part = EE_TRUE;
             break;
+        case 'c':
+            args->compact = EE_TRUE;
+            compact_specified = EE_TRUE;
+            break;
+        case 'S':
+            args->stats = EE_TRUE;
+            if (NULL == optarg) {
+                break;
+            }
+
+            if (0 != strcmp(optarg, "json")) {
+                fprintf(stderr, "%s: '--stats' accepts only 'json' format\n",
+                        argv[0]);
+                EE_SEE_HELP(argv[0]);
+                status = EE_FAILURE;
+                goto end;
+            }
+
+            args->stats_json = EE_TRUE;
+            break;
         case 'o':
             EE_CHECK_OPTARG(argv[0], "'--output'", status, end);
             args->output_file = optarg;
@@ -209,6 +290,26 @@ ee_args_parse(ee_args_t *args, int argc, char *argv[])
                 argv[0]);
     }
 
+    if (EE_TRUE == compact_specified && EE_MODE_DECRYPT == args->mode) {
+        printf("%s: '--compact' has no effect in decryption mode\n", argv[0]);
+    }
+
+    if (1 < args->threads && 0 != args->window
+            && EE_MODE_DECRYPT == args->mode) {
+        fprintf(stderr, "%s: '--threads' cannot be combined with '--window' "
+                "in decryption mode; streaming decryption restores blocks "
+                "one at a time\n", argv[0]);
+        EE_SEE_HELP(argv[0]);
+        status = EE_FAILURE;
+        goto end;
+    }
+
+    if (EE_TRUE == dump_sources_specified && 0 != args->window
+            && EE_MODE_ENCRYPT == args->mode) {
+        printf("%s: '--dump-sources' has no effect in streaming mode\n",
+                argv[0]);
+    }
+
     if (EE_FALSE == output_specified) {
         EE_USED_DEFAULT_VALUE(argv[0], "'--output'", EE_OUTPUT_FILE_DEFAULT_STR);
     }
@@ -236,6 +337,20 @@ ee_print_help_msg_s(void)
            "\t                             \tto message source without memory; the value must be in\n"
            "\t                             \trange [%d; %d]; '%d' by default\n",
            EE_MU_MIN, EE_MU_MAX, EE_MU_DEFAULT);
+    printf("\t-t, --threads=[VALUE]        \tspecifies the number of threads which numerate or\n"
+           "\t                             \trestore blocks in parallel; the output does not depend\n"
+           "\t                             \ton this value; the value must be in range [%d; %d];\n"
+           "\t                             \tin decryption mode it must be 1 with '--window';\n"
+           "\t                             \t'%d' by default\n",
+           EE_THREADS_MIN, EE_THREADS_MAX, EE_THREADS_DEFAULT);
+    printf("\t-w, --window=[VALUE]         \tenables streaming; at most VALUE megabytes of source\n"
+           "\t                             \tcharacters are kept in memory; in encryption mode the input\n"
+           "\t                             \tis read once and the rest goes to a temporary file; in\n"
+           "\t                             \tdecryption mode restored blocks are evicted and restored\n"
+           "\t                             \tagain when needed; '0' disables streaming; the value\n"
+           "\t                             \tmust be in range [%d; %d];\n"
+           "\t                             \t'%d' by default\n",
+           EE_WINDOW_MIN, EE_WINDOW_MAX, EE_WINDOW_DEFAULT);
     printf("\t-d, --dump-sources           \tin encryption mode creates file 'sources.dump' with result of\n"
            "\t                             \tsource splitting; in decryption mode has no effect\n");
     printf("\t-p, --part                   \tin encryption mode splits output into two files - FILE.pri and\n"
@@ -243,11 +358,21 @@ ee_print_help_msg_s(void)
            "\t                             \tpublic data (statistics, prefixes, etc.); in decryption mode\n"
            "\t                             \tspecifies that public and private data need to take from two\n"
            "\t                             \tdifferent files INPUT.pub and INPUT.pri files\n");
+    printf("\t-c, --compact                \tin encryption mode writes the statistics of each block as\n"
+           "\t                             \tan alphabet presence bitmap and the enumerative index of\n"
+           "\t                             \tthe nonzero counts instead of %d fixed-width counts;\n"
+           "\t                             \tin decryption mode has no effect, the format of each\n"
+           "\t                             \tblock is detected automatically\n",
+           EE_ALPHABET_SIZE);
     printf("\t-o, --output=[FILE]          \tspecifies the output file to which to write the result\n"
            "\t                             \tof the encryption or decryption (depending on the --mode);\n"
            "\t                             \t'%s' by default\n", EE_OUTPUT_FILE_DEFAULT);
     printf("\t-k, --key=[KEY]              \tspecifies the secret key for encryption or decryption\n"
            "\t                             \tthe message\n");
+    printf("\t    --stats[=json]           \tprints the time spent in each stage of the encryption or\n"
+           "\t                             \tdecryption and the numbers of blocks, sources, written bits\n"
+           "\t                             \tand allocated GMP bytes to stderr; 'json' prints them as\n"
+           "\t                             \ta single JSON object\n");
     printf("\t-h, --help                   \tshow this help message\n");
     printf("\n");
 }
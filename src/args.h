@@ -12,8 +12,13 @@ typedef struct ee_args_s {
     ee_mode_t mode;
     ee_size_t sigma;
     ee_size_t mu;
+    ee_size_t threads;
+    ee_size_t window;
     ee_bool_t dump_sources;
     ee_bool_t part;
+    ee_bool_t compact;
+    ee_bool_t stats;
+    ee_bool_t stats_json;
     const ee_char_t *key;
     const ee_char_t *input_file;
     const ee_char_t *output_file;
@@ -5,6 +5,7 @@
 #include <limits.h>
 
 #define EE_BITS_IN_BYTE 8
+#define EE_BYTE_MASK ((1 << EE_BITS_IN_BYTE) - 1)
 #define EE_EVAL_BYTES_NUMBER(bits_number) \
         ((bits_number) / EE_BITS_IN_BYTE \
         + ((bits_number) % EE_BITS_IN_BYTE == 0 ? 0 : 1))
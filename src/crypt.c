@@ -1,9 +1,12 @@
 #include <stdlib.h>
+#include <pthread.h>
 #include <gmp.h>
 
 #include "crypt.h"
 
 #include "encryption.h"
+#include "stream.h"
+#include "profile.h"
 
 #define EE_GOTO_IF_NOT_SUCCESS(status, label) \
         if (EE_SUCCESS != (status)) { \
@@ -18,42 +21,249 @@
 
 #define EE_BREAK_IF_NOT_SUCCESS(status) EE_BREAK_IF((EE_SUCCESS != (status)))
 
+#define EE_JOBS_PER_THREAD 4
+
+#define EE_JOB_PENDING 0
+#define EE_JOB_DONE 1
+
+#define EE_STREAM_BLOCKS_MIN 64
+
+typedef struct ee_crypt_job_s {
+    ee_int_t state;
+    ee_bool_t is_block;
+    ee_source_t *source;
+    ee_char_t last_char;
+    ee_block_t block;
+    ee_statistics_t statistics;
+    ee_subnumber_t subnumber;
+    mpz_t rho;
+    mpz_t delta;
+    ee_serializer_ctx_t sctx;
+    ee_sdata_t si_data;
+    ee_sdata_t statistics_data;
+    ee_sdata_t subset_data;
+    ee_sdata_t subnum_data;
+    ee_int_t status;
+} ee_crypt_job_t;
+
+typedef struct ee_crypt_pool_s ee_crypt_pool_t;
+
+typedef struct ee_crypt_worker_s {
+    pthread_t thread;
+    ee_crypt_pool_t *pool;
+    ee_numeration_ctx_t nctx;
+    ee_number_t number;
+} ee_crypt_worker_t;
+
+typedef ee_int_t ee_crypt_process_handler_t(ee_crypt_job_t *job,
+        ee_crypt_worker_t *worker);
+typedef ee_int_t ee_crypt_write_handler_t(ee_crypt_job_t *job,
+        ee_crypt_pool_t *pool);
+
+/*
+ * What the index pass learns about a block: where its statistics and its
+ * subnumber start, where the keystream is at its subnumber, and its subset,
+ * subnumber length and delta, so that loading it does not evaluate them again.
+ */
+typedef struct ee_decrypt_stream_block_s {
+    ee_file_pos_t pub_pos;
+    ee_file_pos_t pri_pos;
+    ee_bit_info_t key_pos;
+    ee_int_t subset;
+    ee_size_t subnum_bit_length;
+    mpz_t delta;
+    ee_bool_t first;
+} ee_decrypt_stream_block_t;
+
+typedef struct ee_decrypt_stream_context_s {
+    ee_file_t *pub_infile;
+    ee_file_t *pri_infile;
+    ee_key_t *key;
+    ee_numeration_ctx_t nctx;
+    ee_crypt_job_t job;
+    ee_number_t number;
+    ee_decrypt_stream_block_t *blocks;
+    ee_size_t blocks_number;
+    ee_size_t blocks_capacity;
+} ee_decrypt_stream_context_t;
+
+struct ee_crypt_pool_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t job_pushed;
+    pthread_cond_t job_done;
+    ee_crypt_job_t *jobs;
+    ee_size_t jobs_number;
+    ee_size_t next_push;
+    ee_size_t next_take;
+    ee_size_t next_write;
+    ee_bool_t stop;
+    ee_crypt_worker_t *workers;
+    ee_size_t workers_number;
+    ee_crypt_process_handler_t *process;
+    ee_crypt_write_handler_t *write;
+    ee_file_t *pub_file;
+    ee_file_t *pri_file;
+    ee_key_t *key;
+    ee_size_t mu;
+    ee_int_t format;
+    ee_int_t status;
+};
+
 ee_int_t
 ee_encrypt_source_list_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
-        ee_source_list_t *sources, ee_key_t *key, ee_size_t sigma);
+        ee_source_list_t *sources, ee_key_t *key, ee_size_t sigma,
+        ee_int_t format);
+ee_int_t
+ee_encrypt_source_list_parallel_s(ee_file_t *pub_outfile,
+        ee_file_t *pri_outfile, ee_source_list_t *sources, ee_key_t *key,
+        ee_size_t sigma, ee_size_t threads, ee_int_t format);
+ee_int_t
+ee_encrypt_stream_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
+        ee_file_t *infile, ee_key_t *key, ee_size_t sigma, ee_size_t mu,
+        ee_size_t threads, ee_size_t window, ee_int_t format);
+ee_int_t
+ee_encrypt_stream_slices_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
+        ee_stream_t *stream, ee_key_t *key, ee_size_t sigma, ee_int_t format);
+ee_int_t
+ee_encrypt_stream_slices_parallel_s(ee_file_t *pub_outfile,
+        ee_file_t *pri_outfile, ee_stream_t *stream, ee_key_t *key,
+        ee_size_t sigma, ee_size_t threads, ee_int_t format);
 ee_int_t
 ee_encrypt_source_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
-        ee_source_t *source, ee_key_t *key, ee_size_t sigma, ee_size_t mu);
+        ee_source_t *source, ee_key_t *key, ee_numeration_ctx_t *nctx,
+        ee_size_t mu, ee_int_t format);
+ee_int_t
+ee_encrypt_source_info_s(ee_file_t *pub_outfile, ee_source_t *source,
+        ee_char_t last_char, ee_size_t length, ee_size_t mu);
 ee_int_t
 ee_encrypt_source_chars_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
-        ee_source_t *source, ee_key_t *key, ee_size_t sigma);
+        ee_source_t *source, ee_key_t *key, ee_numeration_ctx_t *nctx,
+        ee_int_t format);
+ee_int_t
+ee_encrypt_block_serialize_s(ee_sdata_t *statistics_data,
+        ee_sdata_t *subset_data, ee_sdata_t *subnum_data, ee_block_t *block,
+        ee_numeration_ctx_t *nctx, ee_serializer_ctx_t *sctx,
+        ee_number_t *number, ee_subnumber_t *subnumber, ee_int_t format);
+ee_int_t
+ee_encrypt_block_write_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
+        ee_sdata_t *statistics_data, ee_sdata_t *subset_data,
+        ee_sdata_t *subnum_data, ee_key_t *key);
 
 ee_int_t
 ee_decrypt_source_list_s(ee_source_list_t *sources, ee_file_t *pub_infile,
         ee_file_t *pri_infile, ee_key_t *key, ee_size_t sigma);
 ee_int_t
+ee_decrypt_source_list_parallel_s(ee_source_list_t *sources,
+        ee_file_t *pub_infile, ee_file_t *pri_infile, ee_key_t *key,
+        ee_size_t sigma, ee_size_t threads);
+ee_int_t
+ee_decrypt_stream_s(ee_file_t *outfile, ee_file_t *pub_infile,
+        ee_file_t *pri_infile, ee_key_t *key, ee_size_t sigma, ee_size_t mu,
+        ee_size_t window);
+ee_int_t
+ee_decrypt_stream_index_s(ee_stream_reader_t *reader,
+        ee_decrypt_stream_context_t *ctx);
+ee_int_t
+ee_decrypt_source_info_s(ee_source_t *source, ee_char_t *last_char,
+        ee_size_t *length, ee_file_t *pub_infile, ee_size_t mu);
+ee_int_t
 ee_decrypt_source_s(ee_source_t *source, ee_file_t *pub_infile,
-        ee_file_t *pri_infile, ee_key_t *key, ee_size_t sigma, ee_size_t mu);
+        ee_file_t *pri_infile, ee_key_t *key, ee_numeration_ctx_t *nctx,
+        ee_size_t mu);
 ee_int_t
 ee_decrypt_source_chars_s(ee_source_t *source, ee_file_t *pub_infile,
-        ee_file_t *pri_infile, ee_size_t length, ee_key_t *key, ee_size_t sigma);
+        ee_file_t *pri_infile, ee_size_t length, ee_key_t *key,
+        ee_numeration_ctx_t *nctx);
+ee_int_t
+ee_decrypt_statistics_read_s(ee_sdata_t *statistics_data,
+        ee_serializer_ctx_t *sctx, ee_file_t *pub_infile, ee_size_t sigma);
+ee_int_t
+ee_decrypt_block_read_s(ee_crypt_job_t *job, ee_file_t *pub_infile,
+        ee_file_t *pri_infile, ee_key_t *key, ee_numeration_ctx_t *nctx);
+ee_int_t
+ee_decrypt_block_header_read_s(ee_crypt_job_t *job, ee_file_t *pub_infile,
+        ee_size_t sigma);
+ee_int_t
+ee_decrypt_block_subnum_read_s(ee_crypt_job_t *job, ee_file_t *pri_infile,
+        ee_key_t *key);
+void
+ee_decrypt_block_restore_s(ee_crypt_job_t *job, ee_numeration_ctx_t *nctx,
+        ee_number_t *number);
 
 typedef struct ee_encrypt_source_context_s {
     ee_file_t *pub_outfile;
     ee_file_t *pri_outfile;
     ee_key_t *key;
-    ee_size_t sigma;
+    ee_numeration_ctx_t *nctx;
     ee_size_t mu;
+    ee_int_t format;
     ee_int_t status;
 } ee_encrypt_source_context_t;
 
 static ee_bool_t
 ee_encrypt_source_handler_s(ee_source_t *source, void *context);
-
+static ee_bool_t
+ee_encrypt_slice_handler_s(ee_source_t *source, void *context);
+static ee_int_t
+ee_encrypt_stream_traverse_s(ee_stream_t *stream,
+        ee_traverse_handler_t *handler, void *context, ee_int_t *result);
+
+static ee_int_t
+ee_crypt_job_init_s(ee_crypt_job_t *job, ee_size_t sigma);
+static void
+ee_crypt_job_deinit_s(ee_crypt_job_t *job);
+
+static ee_int_t
+ee_crypt_pool_init_s(ee_crypt_pool_t *pool, ee_size_t threads,
+        ee_size_t sigma, ee_crypt_process_handler_t *process,
+        ee_crypt_write_handler_t *write);
+static void
+ee_crypt_pool_deinit_s(ee_crypt_pool_t *pool);
+static ee_crypt_job_t *
+ee_crypt_pool_acquire_s(ee_crypt_pool_t *pool);
+static void
+ee_crypt_pool_push_s(ee_crypt_pool_t *pool);
+static ee_int_t
+ee_crypt_pool_write_next_s(ee_crypt_pool_t *pool);
+static ee_int_t
+ee_crypt_pool_flush_s(ee_crypt_pool_t *pool);
+static void *
+ee_crypt_worker_s(void *arg);
+
+static ee_int_t
+ee_encrypt_job_process_s(ee_crypt_job_t *job, ee_crypt_worker_t *worker);
+static ee_int_t
+ee_encrypt_job_write_s(ee_crypt_job_t *job, ee_crypt_pool_t *pool);
+static ee_bool_t
+ee_encrypt_pool_push_info_s(ee_crypt_pool_t *pool, ee_source_t *source,
+        ee_char_t last_char, ee_size_t length);
+static ee_bool_t
+ee_encrypt_pool_push_chars_s(ee_crypt_pool_t *pool, ee_source_t *source);
+static ee_bool_t
+ee_encrypt_source_parallel_handler_s(ee_source_t *source, void *context);
+static ee_bool_t
+ee_encrypt_slice_parallel_handler_s(ee_source_t *source, void *context);
+
+static ee_int_t
+ee_decrypt_job_process_s(ee_crypt_job_t *job, ee_crypt_worker_t *worker);
+static ee_int_t
+ee_decrypt_job_write_s(ee_crypt_job_t *job, ee_crypt_pool_t *pool);
+static ee_int_t
+ee_decrypt_source_chars_parallel_s(ee_crypt_pool_t *pool,
+        ee_source_t *source, ee_size_t length, ee_numeration_ctx_t *nctx);
+
+static ee_int_t
+ee_decrypt_stream_block_index_s(ee_decrypt_stream_context_t *ctx,
+        ee_bool_t first);
+static void
+ee_decrypt_stream_blocks_free_s(ee_decrypt_stream_context_t *ctx);
+static ee_int_t
+ee_decrypt_stream_load_s(ee_stream_source_t *item, ee_block_t **block,
+        void *context);
 ee_int_t
 ee_encrypt(ee_file_t *pub_outfile, ee_file_t *pri_outfile, ee_file_t *infile,
         ee_file_t *srcsfile, const ee_char_t *key_data, ee_size_t sigma,
-        ee_size_t mu)
+        ee_size_t mu, ee_size_t threads, ee_size_t window, ee_int_t format)
 {
     ee_int_t status;
 
@@ -62,15 +272,32 @@ ee_encrypt(ee_file_t *pub_outfile, ee_file_t *pri_outfile, ee_file_t *infile,
 
     ee_key_t key;
 
+    uint64_t start;
+
     status = ee_key_init(&key, key_data);
     EE_GOTO_IF_NOT_SUCCESS(status, key_init_error);
+    if (0 != window) {
+        status = ee_encrypt_stream_s(pub_outfile, pri_outfile, infile, &key,
+                sigma, mu, threads, window, format);
+        goto encrypt_stream_end;
+    }
+
     ee_source_list_init(&sources, mu);
+    start = ee_profile_start();
     status = ee_file_read_message(&message, infile);
+    ee_profile_stop(EE_PROFILE_READ, start);
     EE_GOTO_IF_NOT_SUCCESS(status, message_read_error);
+    start = ee_profile_start();
     status = ee_source_split(&sources, &message);
+    ee_profile_stop(EE_PROFILE_SPLIT, start);
     EE_GOTO_IF_NOT_SUCCESS(status, source_split_error);
-    status = ee_encrypt_source_list_s(pub_outfile, pri_outfile, &sources, &key,
-            sigma);
+    if (1 < threads) {
+        status = ee_encrypt_source_list_parallel_s(pub_outfile, pri_outfile,
+                &sources, &key, sigma, threads, format);
+    } else {
+        status = ee_encrypt_source_list_s(pub_outfile, pri_outfile, &sources,
+                &key, sigma, format);
+    }
     EE_GOTO_IF_NOT_SUCCESS(status, encrypt_source_error);
     if (NULL != srcsfile) {
         status = ee_file_dump_sources(srcsfile, &sources);
@@ -81,6 +308,7 @@ source_split_error:
     ee_message_deinit(&message);
 message_read_error:
     ee_source_list_deinit(&sources);
+encrypt_stream_end:
     ee_key_deinit(&key);
 key_init_error:
     return status;
@@ -88,7 +316,8 @@ key_init_error:
 
 ee_int_t
 ee_decrypt(ee_file_t *outfile, ee_file_t *pub_infile, ee_file_t *pri_infile,
-        const ee_char_t *key_data, ee_size_t sigma, ee_size_t mu)
+        const ee_char_t *key_data, ee_size_t sigma, ee_size_t mu,
+        ee_size_t threads, ee_size_t window)
 {
     ee_int_t status;
 
@@ -99,24 +328,42 @@ ee_decrypt(ee_file_t *outfile, ee_file_t *pub_infile, ee_file_t *pri_infile,
 
     ee_size_t message_length;
 
+    uint64_t start;
+
     status = ee_key_init(&key, key_data);
     EE_GOTO_IF_NOT_SUCCESS(status, key_init_error);
+    if (0 != window) {
+        status = ee_decrypt_stream_s(outfile, pub_infile, pri_infile, &key,
+                sigma, mu, window);
+        goto decrypt_stream_end;
+    }
+
     ee_source_list_init(&sources, mu);
-    status = ee_decrypt_source_list_s(&sources, pub_infile, pri_infile, &key,
-            sigma);
+    if (1 < threads) {
+        status = ee_decrypt_source_list_parallel_s(&sources, pub_infile,
+                pri_infile, &key, sigma, threads);
+    } else {
+        status = ee_decrypt_source_list_s(&sources, pub_infile, pri_infile,
+                &key, sigma);
+    }
     EE_GOTO_IF_NOT_SUCCESS(status, decrypt_sources_error);
     message_length = ee_source_list_eval_message_length(&sources);
     status = ee_message_init(&message, message_length);
     EE_GOTO_IF_NOT_SUCCESS(status, message_init_error);
+    start = ee_profile_start();
     status = ee_source_merge(&message, &sources);
+    ee_profile_stop(EE_PROFILE_MERGE, start);
     EE_GOTO_IF_NOT_SUCCESS(status, sources_merge_error);
+    start = ee_profile_start();
     status = ee_file_write_message(outfile, &message);
+    ee_profile_stop(EE_PROFILE_WRITE, start);
 
 sources_merge_error:
     ee_message_deinit(&message);
 message_init_error:
 decrypt_sources_error:
     ee_source_list_deinit(&sources);
+decrypt_stream_end:
     ee_key_deinit(&key);
 key_init_error:
     return status;
@@ -124,39 +371,176 @@ key_init_error:
 
 ee_int_t
 ee_encrypt_source_list_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
-        ee_source_list_t *sources, ee_key_t *key, ee_size_t sigma)
+        ee_source_list_t *sources, ee_key_t *key, ee_size_t sigma,
+        ee_int_t format)
 {
     ee_encrypt_source_context_t context;
+    ee_numeration_ctx_t nctx;
+
+    context.status = ee_numeration_ctx_init(&nctx, sigma);
+    if (EE_SUCCESS != context.status) {
+        return context.status;
+    }
 
     context.pub_outfile = pub_outfile;
     context.pri_outfile = pri_outfile;
     context.key = key;
-    context.sigma = sigma;
+    context.nctx = &nctx;
     context.mu = sources->mu;
+    context.format = format;
 
     ee_source_list_traverse(sources, ee_encrypt_source_handler_s, &context);
 
+    ee_numeration_ctx_deinit(&nctx);
+
     return context.status;
 }
 
+ee_int_t
+ee_encrypt_source_list_parallel_s(ee_file_t *pub_outfile,
+        ee_file_t *pri_outfile, ee_source_list_t *sources, ee_key_t *key,
+        ee_size_t sigma, ee_size_t threads, ee_int_t format)
+{
+    ee_int_t status;
+
+    ee_crypt_pool_t pool;
+
+    pool.pub_file = pub_outfile;
+    pool.pri_file = pri_outfile;
+    pool.key = key;
+    pool.mu = sources->mu;
+    pool.format = format;
+
+    status = ee_crypt_pool_init_s(&pool, threads, sigma,
+            ee_encrypt_job_process_s, ee_encrypt_job_write_s);
+    EE_GOTO_IF_NOT_SUCCESS(status, pool_init_error);
+    ee_source_list_traverse(sources, ee_encrypt_source_parallel_handler_s,
+            &pool);
+    status = ee_crypt_pool_flush_s(&pool);
+
+    ee_crypt_pool_deinit_s(&pool);
+pool_init_error:
+    return status;
+}
+
+ee_int_t
+ee_encrypt_stream_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
+        ee_file_t *infile, ee_key_t *key, ee_size_t sigma, ee_size_t mu,
+        ee_size_t threads, ee_size_t window, ee_int_t format)
+{
+    ee_int_t status;
+
+    ee_stream_t stream;
+
+    status = ee_stream_init(&stream, infile, sigma, mu, window);
+    EE_GOTO_IF_NOT_SUCCESS(status, stream_init_error);
+    if (1 < threads) {
+        status = ee_encrypt_stream_slices_parallel_s(pub_outfile, pri_outfile,
+                &stream, key, sigma, threads, format);
+    } else {
+        status = ee_encrypt_stream_slices_s(pub_outfile, pri_outfile, &stream,
+                key, sigma, format);
+    }
+
+    ee_stream_deinit(&stream);
+stream_init_error:
+    return status;
+}
+
+ee_int_t
+ee_encrypt_stream_slices_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
+        ee_stream_t *stream, ee_key_t *key, ee_size_t sigma, ee_int_t format)
+{
+    ee_int_t status;
+
+    ee_encrypt_source_context_t context;
+    ee_numeration_ctx_t nctx;
+
+    status = ee_numeration_ctx_init(&nctx, sigma);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    context.pub_outfile = pub_outfile;
+    context.pri_outfile = pri_outfile;
+    context.key = key;
+    context.nctx = &nctx;
+    context.mu = stream->sources.mu;
+    context.format = format;
+    context.status = EE_SUCCESS;
+
+    status = ee_encrypt_stream_traverse_s(stream, ee_encrypt_slice_handler_s,
+            &context, &(context.status));
+
+    ee_numeration_ctx_deinit(&nctx);
+
+    return status;
+}
+
+ee_int_t
+ee_encrypt_stream_slices_parallel_s(ee_file_t *pub_outfile,
+        ee_file_t *pri_outfile, ee_stream_t *stream, ee_key_t *key,
+        ee_size_t sigma, ee_size_t threads, ee_int_t format)
+{
+    ee_int_t status;
+
+    ee_crypt_pool_t pool;
+
+    pool.pub_file = pub_outfile;
+    pool.pri_file = pri_outfile;
+    pool.key = key;
+    pool.mu = stream->sources.mu;
+    pool.format = format;
+
+    status = ee_crypt_pool_init_s(&pool, threads, sigma,
+            ee_encrypt_job_process_s, ee_encrypt_job_write_s);
+    EE_GOTO_IF_NOT_SUCCESS(status, pool_init_error);
+    status = ee_encrypt_stream_traverse_s(stream,
+            ee_encrypt_slice_parallel_handler_s, &pool, &(pool.status));
+    if (EE_SUCCESS == status) {
+        status = ee_crypt_pool_flush_s(&pool);
+    }
+
+    ee_crypt_pool_deinit_s(&pool);
+pool_init_error:
+    return status;
+}
+
 ee_int_t
 ee_encrypt_source_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
-        ee_source_t *source, ee_key_t *key, ee_size_t sigma, ee_size_t mu)
+        ee_source_t *source, ee_key_t *key, ee_numeration_ctx_t *nctx,
+        ee_size_t mu, ee_int_t format)
 {
     ee_int_t status;
 
-    ee_sdata_t si_sdata;
+    status = ee_encrypt_source_info_s(pub_outfile, source,
+            source->chars[source->length - 1], source->length, mu);
+    if (EE_SUCCESS == status && 1 != source->length) {
+        status = ee_encrypt_source_chars_s(pub_outfile, pri_outfile, source,
+                key, nctx, format);
+    }
+
+    return status;
+}
+
+ee_int_t
+ee_encrypt_source_info_s(ee_file_t *pub_outfile, ee_source_t *source,
+        ee_char_t last_char, ee_size_t length, ee_size_t mu)
+{
+    ee_int_t status;
+
+    ee_sdata_t si_sdata = EE_SDATA_DEFAULT;
+    uint64_t start;
 
-    status = ee_source_info_serialize(&si_sdata, source, mu);
+    status = ee_source_info_serialize(&si_sdata, source, last_char, length,
+            mu);
     EE_GOTO_IF_NOT_SUCCESS(status, si_sdata_serialize_error);
+    start = ee_profile_start();
     status = ee_file_write_sdata(pub_outfile, &si_sdata);
-    EE_GOTO_IF_NOT_SUCCESS(status, si_sdata_write_error);
-    if (1 != source->length) {
-        status = ee_encrypt_source_chars_s(pub_outfile, pri_outfile, source,
-                key, sigma);
-    }
+    ee_profile_stop(EE_PROFILE_WRITE, start);
+    ee_profile_count(EE_PROFILE_SOURCES, 1);
+    ee_profile_count(EE_PROFILE_PUB_BITS, si_sdata.bits_number);
 
-si_sdata_write_error:
     ee_sdata_clear(&si_sdata);
 si_sdata_serialize_error:
     return status;
@@ -164,20 +548,22 @@ si_sdata_serialize_error:
 
 ee_int_t
 ee_encrypt_source_chars_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
-        ee_source_t *source, ee_key_t *key, ee_size_t sigma)
+        ee_source_t *source, ee_key_t *key, ee_numeration_ctx_t *nctx,
+        ee_int_t format)
 {
     ee_size_t status;
     ee_int_t block_status;
 
     ee_block_t block;
-    ee_statistics_t statistics;
     ee_number_t number;
     ee_subnumber_t subnumber;
+    ee_serializer_ctx_t sctx;
 
-    ee_sdata_t statistics_data = { .bytes = NULL, .bits_number = 0 };
-    ee_sdata_t subnum_data = { .bytes = NULL, .bits_number = 0 };
-    ee_sdata_t subset_data = { .bytes = NULL, .bits_number = 0 };
+    ee_sdata_t statistics_data = EE_SDATA_DEFAULT;
+    ee_sdata_t subnum_data = EE_SDATA_DEFAULT;
+    ee_sdata_t subset_data = EE_SDATA_DEFAULT;
 
+    ee_size_t sigma = nctx->sigma;
     ee_size_t offset;
 
     status = ee_block_init(&block, sigma);
@@ -185,39 +571,27 @@ ee_encrypt_source_chars_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
 
     ee_number_init(&number);
     ee_subnumber_init(&subnumber);
+    ee_serializer_ctx_init(&sctx);
 
     offset = 0;
     do {
         block_status = ee_block_from_source(&block, source, offset);
         EE_BREAK_IF(0 == block.length);
         offset += block.length;
-        ee_statistics_gather(&statistics, &block);
-        status = ee_number_eval(&number, &block, &statistics);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        ee_subnumber_eval(&subnumber, &number);
-        status = ee_mpz_serialize(&subnum_data, subnumber.subnum,
-                subnumber.subnum_bit_length);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        ee_sdata_encrypt(&subnum_data, key);
-        status = ee_statistics_serialize(&statistics_data, &statistics, sigma);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        status = ee_subset_serialize(&subset_data, subnumber.subset, sigma);
+        status = ee_encrypt_block_serialize_s(&statistics_data, &subset_data,
+                &subnum_data, &block, nctx, &sctx, &number, &subnumber,
+                format);
         EE_BREAK_IF_NOT_SUCCESS(status);
-        status = ee_file_write_sdata(pub_outfile, &statistics_data);
+        status = ee_encrypt_block_write_s(pub_outfile, pri_outfile,
+                &statistics_data, &subset_data, &subnum_data, key);
         EE_BREAK_IF_NOT_SUCCESS(status);
-        status = ee_file_write_sdata(pub_outfile, &subset_data);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        status = ee_file_write_sdata(pri_outfile, &subnum_data);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        ee_sdata_clear(&subset_data);
-        ee_sdata_clear(&subnum_data);
-        ee_sdata_clear(&statistics_data);
     } while (EE_FINAL_BLOCK != block_status);
 
     ee_sdata_clear(&subset_data);
     ee_sdata_clear(&subnum_data);
     ee_sdata_clear(&statistics_data);
 
+    ee_serializer_ctx_deinit(&sctx);
     ee_subnumber_deinit(&subnumber);
     ee_number_deinit(&number);
 
@@ -226,12 +600,74 @@ block_init_error:
     return status;
 }
 
+ee_int_t
+ee_encrypt_block_serialize_s(ee_sdata_t *statistics_data,
+        ee_sdata_t *subset_data, ee_sdata_t *subnum_data, ee_block_t *block,
+        ee_numeration_ctx_t *nctx, ee_serializer_ctx_t *sctx,
+        ee_number_t *number, ee_subnumber_t *subnumber, ee_int_t format)
+{
+    ee_int_t status;
+
+    ee_statistics_t statistics;
+    uint64_t start;
+
+    start = ee_profile_start();
+    ee_statistics_gather(&statistics, block);
+    ee_number_eval(nctx, number, block, &statistics);
+    ee_subnumber_eval(nctx, subnumber, number);
+    ee_profile_stop(EE_PROFILE_NUMERATE, start);
+    ee_profile_count(EE_PROFILE_BLOCKS, 1);
+    start = ee_profile_start();
+    status = ee_mpz_serialize(subnum_data, subnumber->subnum,
+            subnumber->subnum_bit_length);
+    EE_GOTO_IF_NOT_SUCCESS(status, serialize_error);
+    status = ee_statistics_serialize(sctx, statistics_data, &statistics,
+            block->sigma, format);
+    EE_GOTO_IF_NOT_SUCCESS(status, serialize_error);
+    status = ee_subset_serialize(subset_data, subnumber->subset, block->sigma);
+
+serialize_error:
+    ee_profile_stop(EE_PROFILE_SERIALIZE, start);
+    return status;
+}
+
+ee_int_t
+ee_encrypt_block_write_s(ee_file_t *pub_outfile, ee_file_t *pri_outfile,
+        ee_sdata_t *statistics_data, ee_sdata_t *subset_data,
+        ee_sdata_t *subnum_data, ee_key_t *key)
+{
+    ee_int_t status;
+    uint64_t start;
+
+    start = ee_profile_start();
+    ee_sdata_encrypt(subnum_data, key);
+    status = ee_file_write_sdata(pub_outfile, statistics_data);
+    EE_GOTO_IF_NOT_SUCCESS(status, write_error);
+    status = ee_file_write_sdata(pub_outfile, subset_data);
+    EE_GOTO_IF_NOT_SUCCESS(status, write_error);
+    status = ee_file_write_sdata(pri_outfile, subnum_data);
+    ee_profile_count(EE_PROFILE_PUB_BITS,
+            statistics_data->bits_number + subset_data->bits_number);
+    ee_profile_count(EE_PROFILE_PRI_BITS, subnum_data->bits_number);
+
+write_error:
+    ee_profile_stop(EE_PROFILE_WRITE, start);
+    return status;
+}
+
 ee_int_t
 ee_decrypt_source_list_s(ee_source_list_t *sources, ee_file_t *pub_infile,
         ee_file_t *pri_infile, ee_key_t *key, ee_size_t sigma)
 {
     ee_int_t status;
 
+    ee_numeration_ctx_t nctx;
+
+    status = ee_numeration_ctx_init(&nctx, sigma);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
     do {
         ee_source_t *source;
         source = calloc(1, sizeof(*source));
@@ -246,8 +682,8 @@ ee_decrypt_source_list_s(ee_source_list_t *sources, ee_file_t *pub_infile,
             break;
         }
 
-        status = ee_decrypt_source_s(source, pub_infile, pri_infile, key, sigma,
-                sources->mu);
+        status = ee_decrypt_source_s(source, pub_infile, pri_infile, key,
+                &nctx, sources->mu);
         if (EE_SUCCESS != status) {
             ee_source_deinit(source);
             free(source);
@@ -266,126 +702,953 @@ ee_decrypt_source_list_s(ee_source_list_t *sources, ee_file_t *pub_infile,
         status = EE_SUCCESS;
     }
 
+    ee_numeration_ctx_deinit(&nctx);
+
     return status;
 }
 
 ee_int_t
-ee_decrypt_source_s(ee_source_t *source, ee_file_t *pub_infile,
-        ee_file_t *pri_infile, ee_key_t *key, ee_size_t sigma, ee_size_t mu)
+ee_decrypt_source_list_parallel_s(ee_source_list_t *sources,
+        ee_file_t *pub_infile, ee_file_t *pri_infile, ee_key_t *key,
+        ee_size_t sigma, ee_size_t threads)
+{
+    ee_int_t status;
+
+    ee_crypt_pool_t pool;
+    ee_numeration_ctx_t nctx;
+
+    pool.pub_file = pub_infile;
+    pool.pri_file = pri_infile;
+    pool.key = key;
+    pool.mu = sources->mu;
+
+    status = ee_numeration_ctx_init(&nctx, sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, nctx_init_error);
+    status = ee_crypt_pool_init_s(&pool, threads, sigma,
+            ee_decrypt_job_process_s, ee_decrypt_job_write_s);
+    EE_GOTO_IF_NOT_SUCCESS(status, pool_init_error);
+
+    do {
+        ee_source_t *source;
+        ee_crypt_job_t *job;
+        ee_size_t length;
+        ee_char_t last_char;
+
+        source = calloc(1, sizeof(*source));
+        if (NULL == source) {
+            status = EE_ALLOC_FAILURE;
+            break;
+        }
+
+        status = ee_source_init(source, NULL, sources->mu);
+        if (EE_SUCCESS != status) {
+            free(source);
+            break;
+        }
+
+        status = ee_decrypt_source_info_s(source, &last_char, &length,
+                pub_infile, sources->mu);
+        if (EE_SUCCESS == status) {
+            status = ee_source_reserve(source, length);
+        }
+
+        if (EE_SUCCESS == status) {
+            status = ee_source_list_insert(sources, source);
+        }
+
+        if (EE_SUCCESS != status) {
+            ee_source_deinit(source);
+            free(source);
+            break;
+        }
+
+        if (1 != length) {
+            status = ee_decrypt_source_chars_parallel_s(&pool, source, length,
+                    &nctx);
+            EE_BREAK_IF_NOT_SUCCESS(status);
+        }
+
+        job = ee_crypt_pool_acquire_s(&pool);
+        if (NULL == job) {
+            status = pool.status;
+            break;
+        }
+
+        job->is_block = EE_FALSE;
+        job->source = source;
+        job->last_char = last_char;
+        ee_crypt_pool_push_s(&pool);
+    } while (1);
+
+    if (EE_END_OF_FILE == status) {
+        status = ee_crypt_pool_flush_s(&pool);
+    }
+
+    ee_crypt_pool_deinit_s(&pool);
+pool_init_error:
+    ee_numeration_ctx_deinit(&nctx);
+nctx_init_error:
+    return status;
+}
+
+ee_int_t
+ee_decrypt_stream_s(ee_file_t *outfile, ee_file_t *pub_infile,
+        ee_file_t *pri_infile, ee_key_t *key, ee_size_t sigma, ee_size_t mu,
+        ee_size_t window)
+{
+    ee_int_t status;
+
+    ee_decrypt_stream_context_t ctx;
+    ee_stream_reader_t reader;
+
+    ctx.pub_infile = pub_infile;
+    ctx.pri_infile = pri_infile;
+    ctx.key = key;
+    ctx.blocks = NULL;
+    ctx.blocks_number = 0;
+    ctx.blocks_capacity = 0;
+
+    status = ee_numeration_ctx_init(&(ctx.nctx), sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, nctx_init_error);
+    status = ee_crypt_job_init_s(&(ctx.job), sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, job_init_error);
+    ee_number_init(&(ctx.number));
+    ee_stream_reader_init(&reader, mu, window, ee_decrypt_stream_load_s, &ctx);
+
+    status = ee_decrypt_stream_index_s(&reader, &ctx);
+    EE_GOTO_IF_NOT_SUCCESS(status, index_error);
+    status = ee_stream_merge(outfile, &reader);
+
+index_error:
+    ee_stream_reader_deinit(&reader);
+    ee_decrypt_stream_blocks_free_s(&ctx);
+    ee_number_deinit(&(ctx.number));
+    ee_crypt_job_deinit_s(&(ctx.job));
+job_init_error:
+    ee_numeration_ctx_deinit(&(ctx.nctx));
+nctx_init_error:
+    return status;
+}
+
+ee_int_t
+ee_decrypt_stream_index_s(ee_stream_reader_t *reader,
+        ee_decrypt_stream_context_t *ctx)
 {
     ee_int_t status;
 
-    ee_sdata_t si_sdata;
+    ee_size_t mu = reader->sources.mu;
+
+    do {
+        ee_stream_source_t *item;
+        ee_size_t inc_length;
+
+        item = ee_stream_source_create(NULL, mu);
+        if (NULL == item) {
+            status = EE_ALLOC_FAILURE;
+            break;
+        }
+
+        status = ee_decrypt_source_info_s(&(item->source), &(item->last_char),
+                &(item->total_length), ctx->pub_infile, mu);
+        if (EE_SUCCESS == status) {
+            status = ee_stream_reader_insert(reader, item);
+        }
+
+        if (EE_SUCCESS != status) {
+            ee_stream_source_destroy(item);
+            break;
+        }
+
+        item->current.block = ctx->blocks_number;
+        if (1 == item->total_length) {
+            continue;
+        }
+
+        inc_length = 0;
+        do {
+            status = ee_decrypt_stream_block_index_s(ctx, 0 == inc_length);
+            EE_BREAK_IF_NOT_SUCCESS(status);
+            inc_length += ctx->job.block.length;
+        } while (inc_length < item->total_length - 1);
+
+        if (EE_END_OF_FILE == status) {
+            status = EE_SUCCESS;
+            break;
+        }
+    } while (EE_SUCCESS == status);
+
+    if (EE_END_OF_FILE == status) {
+        status = EE_SUCCESS;
+    }
+
+    return status;
+}
+
+ee_int_t
+ee_decrypt_source_info_s(ee_source_t *source, ee_char_t *last_char,
+        ee_size_t *length, ee_file_t *pub_infile, ee_size_t mu)
+{
+    ee_int_t status;
+
+    ee_sdata_t si_sdata = EE_SDATA_DEFAULT;
     ee_size_t si_bit_length = (mu + 1 + 4) * EE_BITS_IN_BYTE;
+    uint64_t start;
+
+    start = ee_profile_start();
+    status = ee_file_read_sdata(&si_sdata, si_bit_length, pub_infile);
+    EE_GOTO_IF_NOT_SUCCESS(status, si_sdata_read_error);
+    ee_source_info_deserialize(source, last_char, length, &si_sdata, mu);
+    ee_profile_count(EE_PROFILE_SOURCES, 1);
+
+si_sdata_read_error:
+    ee_profile_stop(EE_PROFILE_PARSE, start);
+    ee_sdata_clear(&si_sdata);
+    return status;
+}
+
+ee_int_t
+ee_decrypt_source_s(ee_source_t *source, ee_file_t *pub_infile,
+        ee_file_t *pri_infile, ee_key_t *key, ee_numeration_ctx_t *nctx,
+        ee_size_t mu)
+{
+    ee_int_t status;
 
     ee_char_t last_char;
     ee_size_t length;
 
-    status = ee_file_read_sdata(&si_sdata, si_bit_length, pub_infile);
-    EE_GOTO_IF_NOT_SUCCESS(status, si_sdata_read_error);
-    ee_source_info_deserialize(source, &last_char, &length, &si_sdata, mu);
+    status = ee_decrypt_source_info_s(source, &last_char, &length, pub_infile,
+            mu);
+    EE_GOTO_IF_NOT_SUCCESS(status, source_info_error);
+    status = ee_source_reserve(source, length);
+    EE_GOTO_IF_NOT_SUCCESS(status, source_reserve_error);
     if (1 != length) {
         status = ee_decrypt_source_chars_s(source, pub_infile, pri_infile,
-                length, key, sigma);
+                length, key, nctx);
         EE_GOTO_IF_NOT_SUCCESS(status, decrypt_source_error);
     }
 
     status = ee_source_append_char(source, last_char);
 
 decrypt_source_error:
-si_sdata_read_error:
-    ee_sdata_clear(&si_sdata);
+source_reserve_error:
+source_info_error:
     return status;
 }
 
 ee_int_t
 ee_decrypt_source_chars_s(ee_source_t *source, ee_file_t *pub_infile,
-        ee_file_t *pri_infile, ee_size_t length, ee_key_t *key, ee_size_t sigma)
+        ee_file_t *pri_infile, ee_size_t length, ee_key_t *key,
+        ee_numeration_ctx_t *nctx)
 {
     ee_int_t status;
 
-    ee_block_t block;
-    ee_statistics_t statistics;
+    ee_crypt_job_t job;
     ee_number_t number;
-    ee_subnumber_t subnumber;
-
-    ee_sdata_t statistics_data = { .bytes = NULL, .bits_number = 0 };
-    ee_sdata_t subnum_data = { .bytes = NULL, .bits_number = 0 };
-    ee_sdata_t subset_data = { .bytes = NULL, .bits_number = 0 };
-
-    mpz_t rho = EE_MPZ_NULL;
-    mpz_t delta = EE_MPZ_NULL;
 
     ee_size_t inc_length;
 
-    status = ee_block_init(&block, sigma);
-    EE_GOTO_IF_NOT_SUCCESS(status, block_init_error);
+    status = ee_crypt_job_init_s(&job, nctx->sigma);
+    EE_GOTO_IF_NOT_SUCCESS(status, job_init_error);
 
     ee_number_init(&number);
-    ee_subnumber_init(&subnumber);
-
-    mpz_init(rho);
-    mpz_init(delta);
 
     inc_length = 0;
     do {
-        ee_size_t stats_len = (sigma + 1) * EE_ALPHABET_SIZE;
-        status = ee_file_read_sdata(&statistics_data, stats_len, pub_infile);
+        status = ee_decrypt_statistics_read_s(&(job.statistics_data),
+                &(job.sctx), pub_infile, nctx->sigma);
         if (EE_END_OF_FILE == status) {
             status = EE_SUCCESS;
             break;
         }
 
-        ee_statistics_deserialize(&statistics, &statistics_data, sigma);
-        status = ee_file_read_sdata(&subset_data, sigma + 4, pub_infile);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        ee_subset_deserialize(&(subnumber.subset), &subset_data);
-        ee_block_generate(&block, &statistics);
-        status = ee_eval_rho(rho, &block, &statistics);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        status = ee_eval_delta(delta, rho, &block, &statistics);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        ee_eval_subnum_bit_length(&(subnumber.subnum_bit_length), delta,
-                subnumber.subset);
-        status = ee_file_read_sdata(&subnum_data, subnumber.subnum_bit_length,
-                pri_infile);
-        EE_BREAK_IF_NOT_SUCCESS(status);
-        ee_sdata_decrypt(&subnum_data, key);
-        ee_mpz_deserialize(subnumber.subnum, subnumber.subnum_bit_length,
-                &subnum_data);
-        ee_number_restore(&number, delta, &subnumber);
-        status = ee_block_restore(&block, &statistics, rho, &number);
+        status = ee_decrypt_block_read_s(&job, pub_infile, pri_infile, key,
+                nctx);
         EE_BREAK_IF_NOT_SUCCESS(status);
-        status = ee_source_append_block(source, &block);
+        ee_decrypt_block_restore_s(&job, nctx, &number);
+        status = ee_source_append_block(source, &(job.block));
         EE_BREAK_IF_NOT_SUCCESS(status);
-        inc_length += block.length;
-        ee_sdata_clear(&subset_data);
-        ee_sdata_clear(&subnum_data);
-        ee_sdata_clear(&statistics_data);
+        inc_length += job.block.length;
     } while (inc_length < length - 1);
 
-    mpz_clear(delta);
-    mpz_clear(rho);
+    ee_number_deinit(&number);
 
-    ee_sdata_clear(&subset_data);
-    ee_sdata_clear(&subnum_data);
-    ee_sdata_clear(&statistics_data);
+    ee_crypt_job_deinit_s(&job);
+job_init_error:
+    return status;
+}
 
-    ee_subnumber_deinit(&subnumber);
-    ee_number_deinit(&number);
+ee_int_t
+ee_decrypt_statistics_read_s(ee_sdata_t *statistics_data,
+        ee_serializer_ctx_t *sctx, ee_file_t *pub_infile, ee_size_t sigma)
+{
+    ee_int_t status;
 
-    ee_block_deinit(&block);
-block_init_error:
+    ee_size_t prefix_bit_length = ee_statistics_prefix_bit_length(sigma);
+    ee_size_t bit_length;
+    uint64_t start;
+
+    start = ee_profile_start();
+    status = ee_file_read_sdata(statistics_data, prefix_bit_length,
+            pub_infile);
+    EE_GOTO_IF_NOT_SUCCESS(status, read_error);
+    bit_length = ee_statistics_bit_length(sctx, statistics_data, sigma);
+    status = ee_file_read_sdata_append(statistics_data,
+            bit_length - prefix_bit_length, pub_infile);
+
+read_error:
+    ee_profile_stop(EE_PROFILE_PARSE, start);
+    return status;
+}
+
+ee_int_t
+ee_decrypt_block_read_s(ee_crypt_job_t *job, ee_file_t *pub_infile,
+        ee_file_t *pri_infile, ee_key_t *key, ee_numeration_ctx_t *nctx)
+{
+    ee_int_t status;
+
+    ee_subnumber_t *subnumber = &(job->subnumber);
+    uint64_t start;
+
+    status = ee_decrypt_block_header_read_s(job, pub_infile, nctx->sigma);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    start = ee_profile_start();
+    ee_eval_rho_delta(nctx, job->rho, job->delta, &(job->block),
+            &(job->statistics));
+    ee_eval_subnum_bit_length(&(subnumber->subnum_bit_length), job->delta,
+            subnumber->subset);
+    ee_profile_stop(EE_PROFILE_RESTORE, start);
+
+    return ee_decrypt_block_subnum_read_s(job, pri_infile, key);
+}
+
+ee_int_t
+ee_decrypt_block_header_read_s(ee_crypt_job_t *job, ee_file_t *pub_infile,
+        ee_size_t sigma)
+{
+    ee_int_t status;
+
+    uint64_t start;
+
+    start = ee_profile_start();
+    ee_statistics_deserialize(&(job->sctx), &(job->statistics),
+            &(job->statistics_data), sigma);
+    status = ee_file_read_sdata(&(job->subset_data), sigma + 4, pub_infile);
+    EE_GOTO_IF_NOT_SUCCESS(status, read_error);
+    ee_subset_deserialize(&(job->subnumber.subset), &(job->subset_data));
+    ee_block_generate(&(job->block), &(job->statistics));
+    ee_profile_count(EE_PROFILE_BLOCKS, 1);
+
+read_error:
+    ee_profile_stop(EE_PROFILE_PARSE, start);
+    return status;
+}
+
+ee_int_t
+ee_decrypt_block_subnum_read_s(ee_crypt_job_t *job, ee_file_t *pri_infile,
+        ee_key_t *key)
+{
+    ee_int_t status;
+
+    ee_subnumber_t *subnumber = &(job->subnumber);
+    uint64_t start;
+
+    start = ee_profile_start();
+    status = ee_file_read_sdata(&(job->subnum_data),
+            subnumber->subnum_bit_length, pri_infile);
+    EE_GOTO_IF_NOT_SUCCESS(status, read_error);
+    ee_sdata_decrypt(&(job->subnum_data), key);
+    ee_mpz_deserialize(subnumber->subnum, subnumber->subnum_bit_length,
+            &(job->subnum_data));
+
+read_error:
+    ee_profile_stop(EE_PROFILE_PARSE, start);
     return status;
 }
 
+void
+ee_decrypt_block_restore_s(ee_crypt_job_t *job, ee_numeration_ctx_t *nctx,
+        ee_number_t *number)
+{
+    uint64_t start;
+
+    start = ee_profile_start();
+    ee_number_restore(nctx, number, job->delta, &(job->subnumber));
+    ee_block_restore(nctx, &(job->block), &(job->statistics), job->rho,
+            number);
+    ee_profile_stop(EE_PROFILE_RESTORE, start);
+}
+
 static ee_bool_t
 ee_encrypt_source_handler_s(ee_source_t *source, void *context)
 {
     ee_encrypt_source_context_t *ctx = context;
 
     ctx->status = ee_encrypt_source_s(ctx->pub_outfile, ctx->pri_outfile,
-            source, ctx->key, ctx->sigma, ctx->mu);
+            source, ctx->key, ctx->nctx, ctx->mu, ctx->format);
+
+    return (EE_SUCCESS == ctx->status) ? EE_TRUE : EE_FALSE;
+}
+
+static ee_bool_t
+ee_encrypt_slice_handler_s(ee_source_t *source, void *context)
+{
+    ee_encrypt_source_context_t *ctx = context;
+    ee_stream_source_t *item = (ee_stream_source_t *)source;
+
+    if (0 == item->skip) {
+        ctx->status = ee_encrypt_source_info_s(ctx->pub_outfile, source,
+                item->last_char, item->total_length, ctx->mu);
+    }
+
+    if (EE_SUCCESS == ctx->status && 1 != item->total_length) {
+        ctx->status = ee_encrypt_source_chars_s(ctx->pub_outfile,
+                ctx->pri_outfile, source, ctx->key, ctx->nctx, ctx->format);
+    }
 
     return (EE_SUCCESS == ctx->status) ? EE_TRUE : EE_FALSE;
 }
+
+static ee_int_t
+ee_encrypt_stream_traverse_s(ee_stream_t *stream,
+        ee_traverse_handler_t *handler, void *context, ee_int_t *result)
+{
+    ee_int_t status;
+
+    do {
+        ee_source_list_t slice;
+
+        ee_source_list_init(&slice, stream->sources.mu);
+        status = ee_stream_next_slice(stream, &slice);
+        if (EE_SUCCESS == status) {
+            ee_source_list_traverse(&slice, handler, context);
+            status = *result;
+        }
+
+        ee_source_list_deinit(&slice);
+    } while (EE_SUCCESS == status);
+
+    if (EE_END_OF_FILE == status) {
+        status = EE_SUCCESS;
+    }
+
+    return status;
+}
+
+static ee_int_t
+ee_crypt_job_init_s(ee_crypt_job_t *job, ee_size_t sigma)
+{
+    ee_int_t status;
+
+    status = ee_block_init(&(job->block), sigma);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    ee_subnumber_init(&(job->subnumber));
+    mpz_init(job->rho);
+    mpz_init(job->delta);
+    ee_serializer_ctx_init(&(job->sctx));
+
+    job->si_data = (ee_sdata_t)EE_SDATA_DEFAULT;
+    job->statistics_data = (ee_sdata_t)EE_SDATA_DEFAULT;
+    job->subset_data = (ee_sdata_t)EE_SDATA_DEFAULT;
+    job->subnum_data = (ee_sdata_t)EE_SDATA_DEFAULT;
+
+    return EE_SUCCESS;
+}
+
+static void
+ee_crypt_job_deinit_s(ee_crypt_job_t *job)
+{
+    ee_sdata_clear(&(job->subnum_data));
+    ee_sdata_clear(&(job->subset_data));
+    ee_sdata_clear(&(job->statistics_data));
+    ee_sdata_clear(&(job->si_data));
+
+    ee_serializer_ctx_deinit(&(job->sctx));
+    mpz_clear(job->delta);
+    mpz_clear(job->rho);
+    ee_subnumber_deinit(&(job->subnumber));
+    ee_block_deinit(&(job->block));
+}
+
+static ee_int_t
+ee_crypt_pool_init_s(ee_crypt_pool_t *pool, ee_size_t threads,
+        ee_size_t sigma, ee_crypt_process_handler_t *process,
+        ee_crypt_write_handler_t *write)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_size_t jobs_number = threads * EE_JOBS_PER_THREAD;
+
+    pthread_mutex_init(&(pool->mutex), NULL);
+    pthread_cond_init(&(pool->job_pushed), NULL);
+    pthread_cond_init(&(pool->job_done), NULL);
+
+    pool->jobs_number = 0;
+    pool->workers_number = 0;
+    pool->next_push = 0;
+    pool->next_take = 0;
+    pool->next_write = 0;
+    pool->stop = EE_FALSE;
+    pool->process = process;
+    pool->write = write;
+    pool->status = EE_SUCCESS;
+
+    pool->jobs = calloc(jobs_number, sizeof(*(pool->jobs)));
+    pool->workers = calloc(threads, sizeof(*(pool->workers)));
+    if (NULL == pool->jobs || NULL == pool->workers) {
+        status = EE_ALLOC_FAILURE;
+        goto calloc_error;
+    }
+
+    for (; pool->jobs_number < jobs_number; ++(pool->jobs_number)) {
+        status = ee_crypt_job_init_s(&(pool->jobs[pool->jobs_number]), sigma);
+        EE_GOTO_IF_NOT_SUCCESS(status, job_init_error);
+    }
+
+    for (; pool->workers_number < threads; ++(pool->workers_number)) {
+        ee_crypt_worker_t *worker = &(pool->workers[pool->workers_number]);
+        status = ee_numeration_ctx_init(&(worker->nctx), sigma);
+        EE_GOTO_IF_NOT_SUCCESS(status, worker_init_error);
+        ee_number_init(&(worker->number));
+        worker->pool = pool;
+        if (0 != pthread_create(&(worker->thread), NULL, ee_crypt_worker_s,
+                worker)) {
+            ee_number_deinit(&(worker->number));
+            ee_numeration_ctx_deinit(&(worker->nctx));
+            status = EE_FAILURE;
+            goto worker_init_error;
+        }
+    }
+
+    return EE_SUCCESS;
+
+worker_init_error:
+job_init_error:
+calloc_error:
+    ee_crypt_pool_deinit_s(pool);
+    return status;
+}
+
+static void
+ee_crypt_pool_deinit_s(ee_crypt_pool_t *pool)
+{
+    pthread_mutex_lock(&(pool->mutex));
+    pool->stop = EE_TRUE;
+    pthread_cond_broadcast(&(pool->job_pushed));
+    pthread_mutex_unlock(&(pool->mutex));
+
+    for (ee_size_t i = 0; i < pool->workers_number; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+        ee_number_deinit(&(pool->workers[i].number));
+        ee_numeration_ctx_deinit(&(pool->workers[i].nctx));
+    }
+
+    for (ee_size_t i = 0; i < pool->jobs_number; ++i) {
+        ee_crypt_job_deinit_s(&(pool->jobs[i]));
+    }
+
+    free(pool->workers);
+    free(pool->jobs);
+
+    pthread_cond_destroy(&(pool->job_done));
+    pthread_cond_destroy(&(pool->job_pushed));
+    pthread_mutex_destroy(&(pool->mutex));
+}
+
+static ee_crypt_job_t *
+ee_crypt_pool_acquire_s(ee_crypt_pool_t *pool)
+{
+    if (pool->next_push - pool->next_write == pool->jobs_number) {
+        if (EE_SUCCESS != ee_crypt_pool_write_next_s(pool)) {
+            return NULL;
+        }
+    }
+
+    return &(pool->jobs[pool->next_push % pool->jobs_number]);
+}
+
+static void
+ee_crypt_pool_push_s(ee_crypt_pool_t *pool)
+{
+    pthread_mutex_lock(&(pool->mutex));
+    pool->jobs[pool->next_push % pool->jobs_number].state = EE_JOB_PENDING;
+    pool->next_push += 1;
+    pthread_cond_signal(&(pool->job_pushed));
+    pthread_mutex_unlock(&(pool->mutex));
+}
+
+static ee_int_t
+ee_crypt_pool_write_next_s(ee_crypt_pool_t *pool)
+{
+    ee_crypt_job_t *job = &(pool->jobs[pool->next_write % pool->jobs_number]);
+
+    pthread_mutex_lock(&(pool->mutex));
+    while (EE_JOB_DONE != job->state) {
+        pthread_cond_wait(&(pool->job_done), &(pool->mutex));
+    }
+    pthread_mutex_unlock(&(pool->mutex));
+
+    pool->status = job->status;
+    if (EE_SUCCESS == pool->status) {
+        pool->status = pool->write(job, pool);
+    }
+
+    pool->next_write += 1;
+
+    return pool->status;
+}
+
+static ee_int_t
+ee_crypt_pool_flush_s(ee_crypt_pool_t *pool)
+{
+    while (EE_SUCCESS == pool->status && pool->next_write < pool->next_push) {
+        ee_crypt_pool_write_next_s(pool);
+    }
+
+    return pool->status;
+}
+
+static void *
+ee_crypt_worker_s(void *arg)
+{
+    ee_crypt_worker_t *worker = arg;
+    ee_crypt_pool_t *pool = worker->pool;
+
+    while (1) {
+        ee_crypt_job_t *job;
+
+        pthread_mutex_lock(&(pool->mutex));
+        while (EE_FALSE == pool->stop && pool->next_take == pool->next_push) {
+            pthread_cond_wait(&(pool->job_pushed), &(pool->mutex));
+        }
+
+        if (pool->next_take == pool->next_push) {
+            pthread_mutex_unlock(&(pool->mutex));
+            break;
+        }
+
+        job = &(pool->jobs[pool->next_take % pool->jobs_number]);
+        pool->next_take += 1;
+        pthread_mutex_unlock(&(pool->mutex));
+
+        job->status = EE_SUCCESS;
+        if (EE_TRUE == job->is_block) {
+            job->status = pool->process(job, worker);
+        }
+
+        pthread_mutex_lock(&(pool->mutex));
+        job->state = EE_JOB_DONE;
+        pthread_cond_broadcast(&(pool->job_done));
+        pthread_mutex_unlock(&(pool->mutex));
+    }
+
+    return NULL;
+}
+
+static ee_int_t
+ee_encrypt_job_process_s(ee_crypt_job_t *job, ee_crypt_worker_t *worker)
+{
+    return ee_encrypt_block_serialize_s(&(job->statistics_data),
+            &(job->subset_data), &(job->subnum_data), &(job->block),
+            &(worker->nctx), &(job->sctx), &(worker->number),
+            &(job->subnumber), worker->pool->format);
+}
+
+static ee_int_t
+ee_encrypt_job_write_s(ee_crypt_job_t *job, ee_crypt_pool_t *pool)
+{
+    if (EE_TRUE == job->is_block) {
+        return ee_encrypt_block_write_s(pool->pub_file, pool->pri_file,
+                &(job->statistics_data), &(job->subset_data),
+                &(job->subnum_data), pool->key);
+    }
+
+    ee_profile_count(EE_PROFILE_SOURCES, 1);
+    ee_profile_count(EE_PROFILE_PUB_BITS, job->si_data.bits_number);
+
+    return ee_file_write_sdata(pool->pub_file, &(job->si_data));
+}
+
+static ee_bool_t
+ee_encrypt_pool_push_info_s(ee_crypt_pool_t *pool, ee_source_t *source,
+        ee_char_t last_char, ee_size_t length)
+{
+    ee_crypt_job_t *job;
+
+    job = ee_crypt_pool_acquire_s(pool);
+    if (NULL == job) {
+        return EE_FALSE;
+    }
+
+    job->is_block = EE_FALSE;
+    pool->status = ee_source_info_serialize(&(job->si_data), source,
+            last_char, length, pool->mu);
+    if (EE_SUCCESS != pool->status) {
+        return EE_FALSE;
+    }
+
+    ee_crypt_pool_push_s(pool);
+
+    return EE_TRUE;
+}
+
+static ee_bool_t
+ee_encrypt_pool_push_chars_s(ee_crypt_pool_t *pool, ee_source_t *source)
+{
+    ee_crypt_job_t *job;
+    ee_int_t block_status;
+    ee_size_t offset;
+
+    offset = 0;
+    do {
+        job = ee_crypt_pool_acquire_s(pool);
+        if (NULL == job) {
+            return EE_FALSE;
+        }
+
+        block_status = ee_block_from_source(&(job->block), source, offset);
+        EE_BREAK_IF(0 == job->block.length);
+        offset += job->block.length;
+        job->is_block = EE_TRUE;
+        ee_crypt_pool_push_s(pool);
+    } while (EE_FINAL_BLOCK != block_status);
+
+    return EE_TRUE;
+}
+
+static ee_bool_t
+ee_encrypt_source_parallel_handler_s(ee_source_t *source, void *context)
+{
+    ee_crypt_pool_t *pool = context;
+
+    if (EE_FALSE == ee_encrypt_pool_push_info_s(pool, source,
+            source->chars[source->length - 1], source->length)) {
+        return EE_FALSE;
+    }
+
+    if (1 == source->length) {
+        return EE_TRUE;
+    }
+
+    return ee_encrypt_pool_push_chars_s(pool, source);
+}
+
+static ee_bool_t
+ee_encrypt_slice_parallel_handler_s(ee_source_t *source, void *context)
+{
+    ee_crypt_pool_t *pool = context;
+    ee_stream_source_t *item = (ee_stream_source_t *)source;
+
+    if (0 == item->skip) {
+        if (EE_FALSE == ee_encrypt_pool_push_info_s(pool, source,
+                item->last_char, item->total_length)) {
+            return EE_FALSE;
+        }
+    }
+
+    if (1 == item->total_length) {
+        return EE_TRUE;
+    }
+
+    return ee_encrypt_pool_push_chars_s(pool, source);
+}
+
+static ee_int_t
+ee_decrypt_job_process_s(ee_crypt_job_t *job, ee_crypt_worker_t *worker)
+{
+    ee_decrypt_block_restore_s(job, &(worker->nctx), &(worker->number));
+
+    return EE_SUCCESS;
+}
+
+static ee_int_t
+ee_decrypt_job_write_s(ee_crypt_job_t *job, ee_crypt_pool_t *pool)
+{
+    (void)pool;
+
+    if (EE_TRUE == job->is_block) {
+        return ee_source_append_block(job->source, &(job->block));
+    }
+
+    return ee_source_append_char(job->source, job->last_char);
+}
+
+static ee_int_t
+ee_decrypt_source_chars_parallel_s(ee_crypt_pool_t *pool,
+        ee_source_t *source, ee_size_t length, ee_numeration_ctx_t *nctx)
+{
+    ee_int_t status;
+    ee_crypt_job_t *job;
+    ee_size_t inc_length;
+
+    inc_length = 0;
+    do {
+        job = ee_crypt_pool_acquire_s(pool);
+        if (NULL == job) {
+            return pool->status;
+        }
+
+        status = ee_decrypt_statistics_read_s(&(job->statistics_data),
+                &(job->sctx), pool->pub_file, nctx->sigma);
+        if (EE_END_OF_FILE == status) {
+            return EE_SUCCESS;
+        }
+
+        status = ee_decrypt_block_read_s(job, pool->pub_file, pool->pri_file,
+                pool->key, nctx);
+        EE_BREAK_IF_NOT_SUCCESS(status);
+        job->is_block = EE_TRUE;
+        job->source = source;
+        inc_length += job->block.length;
+        ee_crypt_pool_push_s(pool);
+    } while (inc_length < length - 1);
+
+    return status;
+}
+
+/*
+ * Reads the next block of the input and appends its entry to the table.  The
+ * subnumber is read and decrypted only to move the private input and the
+ * keystream past it.
+ */
+static ee_int_t
+ee_decrypt_stream_block_index_s(ee_decrypt_stream_context_t *ctx,
+        ee_bool_t first)
+{
+    ee_int_t status;
+
+    ee_crypt_job_t *job = &(ctx->job);
+    ee_decrypt_stream_block_t *record;
+    uint64_t start;
+
+    if (ctx->blocks_number == ctx->blocks_capacity) {
+        ee_size_t capacity = 2 * ctx->blocks_capacity;
+        ee_decrypt_stream_block_t *blocks;
+
+        if (EE_STREAM_BLOCKS_MIN > capacity) {
+            capacity = EE_STREAM_BLOCKS_MIN;
+        }
+
+        blocks = realloc(ctx->blocks, capacity * sizeof(*blocks));
+        if (NULL == blocks) {
+            return EE_ALLOC_FAILURE;
+        }
+
+        ctx->blocks = blocks;
+        ctx->blocks_capacity = capacity;
+    }
+
+    record = ctx->blocks + ctx->blocks_number;
+    ee_file_tell(ctx->pub_infile, &(record->pub_pos));
+    status = ee_decrypt_statistics_read_s(&(job->statistics_data),
+            &(job->sctx), ctx->pub_infile, ctx->nctx.sigma);
+    if (EE_SUCCESS == status) {
+        status = ee_decrypt_block_header_read_s(job, ctx->pub_infile,
+                ctx->nctx.sigma);
+    }
+
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    mpz_init(record->delta);
+    ctx->blocks_number += 1;
+    record->first = first;
+    record->subset = job->subnumber.subset;
+    start = ee_profile_start();
+    ee_eval_rho_delta(&(ctx->nctx), job->rho, record->delta, &(job->block),
+            &(job->statistics));
+    ee_eval_subnum_bit_length(&(record->subnum_bit_length), record->delta,
+            record->subset);
+    ee_profile_stop(EE_PROFILE_RESTORE, start);
+
+    ee_file_tell(ctx->pri_infile, &(record->pri_pos));
+    record->key_pos = ctx->key->bit_info;
+    job->subnumber.subnum_bit_length = record->subnum_bit_length;
+
+    return ee_decrypt_block_subnum_read_s(job, ctx->pri_infile, ctx->key);
+}
+
+static void
+ee_decrypt_stream_blocks_free_s(ee_decrypt_stream_context_t *ctx)
+{
+    for (ee_size_t i = 0; i < ctx->blocks_number; ++i) {
+        mpz_clear(ctx->blocks[i].delta);
+    }
+
+    free(ctx->blocks);
+    ctx->blocks = NULL;
+    ctx->blocks_number = 0;
+    ctx->blocks_capacity = 0;
+}
+
+static ee_int_t
+ee_decrypt_stream_load_s(ee_stream_source_t *item, ee_block_t **block,
+        void *context)
+{
+    ee_int_t status;
+    ee_decrypt_stream_context_t *ctx = context;
+
+    ee_crypt_job_t *job = &(ctx->job);
+    ee_decrypt_stream_block_t *record;
+    uint64_t start;
+
+    if (item->current.block >= ctx->blocks_number) {
+        return EE_FAILURE;
+    }
+
+    record = ctx->blocks + item->current.block;
+    status = ee_file_seek(ctx->pub_infile, &(record->pub_pos));
+    if (EE_SUCCESS == status) {
+        status = ee_decrypt_statistics_read_s(&(job->statistics_data),
+                &(job->sctx), ctx->pub_infile, ctx->nctx.sigma);
+    }
+
+    if (EE_SUCCESS == status) {
+        status = ee_file_seek(ctx->pri_infile, &(record->pri_pos));
+    }
+
+    if (EE_SUCCESS != status) {
+        return (EE_END_OF_FILE == status) ? EE_FAILURE : status;
+    }
+
+    start = ee_profile_start();
+    ee_statistics_deserialize(&(job->sctx), &(job->statistics),
+            &(job->statistics_data), ctx->nctx.sigma);
+    ee_block_generate(&(job->block), &(job->statistics));
+    ee_profile_stop(EE_PROFILE_PARSE, start);
+
+    job->subnumber.subset = record->subset;
+    job->subnumber.subnum_bit_length = record->subnum_bit_length;
+    ctx->key->bit_info = record->key_pos;
+    status = ee_decrypt_block_subnum_read_s(job, ctx->pri_infile, ctx->key);
+    if (EE_SUCCESS != status) {
+        return (EE_END_OF_FILE == status) ? EE_FAILURE : status;
+    }
+
+    start = ee_profile_start();
+    ee_eval_rho(&(ctx->nctx), job->rho, &(job->block), &(job->statistics));
+    ee_number_restore(&(ctx->nctx), &(ctx->number), record->delta,
+            &(job->subnumber));
+    ee_block_restore(&(ctx->nctx), &(job->block), &(job->statistics),
+            job->rho, &(ctx->number));
+    ee_profile_stop(EE_PROFILE_RESTORE, start);
+
+    /*
+     * The blocks of a source follow each other in the table and are loaded in
+     * order, so the one before this one is done with for good.
+     */
+    if (EE_FALSE == record->first) {
+        mpz_clear(record[-1].delta);
+        mpz_init(record[-1].delta);
+    }
+
+    item->next.block = item->current.block + 1;
+    *block = &(job->block);
+
+    return EE_SUCCESS;
+}
@@ -7,9 +7,10 @@
 ee_int_t
 ee_encrypt(ee_file_t *pub_outfile, ee_file_t *pri_outfile, ee_file_t *infile,
         ee_file_t *srcsfile, const ee_char_t *key_data, ee_size_t sigma,
-        ee_size_t mu);
+        ee_size_t mu, ee_size_t threads, ee_size_t window, ee_int_t format);
 ee_int_t
 ee_decrypt(ee_file_t *outfile, ee_file_t *pub_infile, ee_file_t *pri_infile,
-        const ee_char_t *key_data, ee_size_t sigma, ee_size_t mu);
+        const ee_char_t *key_data, ee_size_t sigma, ee_size_t mu,
+        ee_size_t threads, ee_size_t window);
 
 #endif /* CRYPT_H */
@@ -6,6 +6,7 @@
 #include "args.h"
 #include "io.h"
 #include "crypt.h"
+#include "profile.h"
 
 #define EE_PUB_EXT ".pub"
 #define EE_PRI_EXT ".pri"
@@ -35,6 +36,10 @@ main(int argc, char *argv[])
         return EE_FAILURE;
     }
 
+    if (EE_TRUE == args.stats) {
+        ee_profile_enable();
+    }
+
     switch (args.mode) {
     case EE_MODE_ENCRYPT:
         status = ee_do_encrypt(&args, argv[0]);
@@ -44,6 +49,9 @@ main(int argc, char *argv[])
         break;
     }
 
+    ee_profile_print(stderr, (EE_TRUE == args.stats_json)
+            ? EE_PROFILE_FORMAT_JSON : EE_PROFILE_FORMAT_TEXT);
+
     return status;
 }
 
@@ -90,7 +98,9 @@ ee_do_encrypt(ee_args_t *args, const char *pname)
     }
 
     status = ee_encrypt(pub_output_ptr, pri_output_ptr, &input, sources_ptr,
-            args->key, args->sigma, args->mu);
+            args->key, args->sigma, args->mu, args->threads, args->window,
+            (EE_TRUE == args->compact) ? EE_STATISTICS_FORMAT_COMPACT
+                    : EE_STATISTICS_FORMAT_PLAIN);
     if (EE_SUCCESS != status) {
         ee_print_error(status);
     }
@@ -143,7 +153,7 @@ ee_do_decrypt(ee_args_t *args, const char *pname)
     }
 
     status = ee_decrypt(&output, pub_input_ptr, pri_input_ptr, args->key,
-            args->sigma, args->mu);
+            args->sigma, args->mu, args->threads, args->window);
     if (EE_SUCCESS != status) {
         ee_print_error(status);
     }
@@ -1,18 +1,17 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "encryption.h"
 
 #include "util.h"
 
+#define EE_KEY_PAD_SIZE sizeof(uint64_t)
+
 static void
 ee_sdata_common_crypt_s(ee_sdata_t *sdata, ee_key_t *key);
-static ee_byte_t
-ee_key_extract_next_byte_s(ee_key_t *key, ee_size_t bits_number);
-static ee_size_t
-ee_key_bit_get_s(ee_key_t *key);
-static void
-ee_key_bit_inc_s(ee_key_t *key);
+static uint64_t
+ee_key_word_at_s(ee_key_t *key, ee_size_t pos);
 
 ee_int_t
 ee_key_init(ee_key_t *key, const ee_char_t *key_data)
@@ -22,13 +21,21 @@ ee_key_init(ee_key_t *key, const ee_char_t *key_data)
     ee_int_t status = EE_SUCCESS;
 
     buffer_len = strlen(key_data);
-    buffer = calloc(buffer_len + 1, sizeof(*buffer));
+    buffer = calloc(buffer_len + EE_KEY_PAD_SIZE, sizeof(*buffer));
     if (NULL == buffer) {
         status = EE_ALLOC_FAILURE;
         goto calloc_error;
     }
 
-    strcpy(buffer, key_data);
+    /*
+     * The key is followed by its own beginning, so that a word of keystream
+     * can be loaded from any byte of the key without wrapping around.
+     */
+    memcpy(buffer, key_data, buffer_len);
+    for (ee_size_t i = buffer_len; 0 != buffer_len
+            && i < buffer_len + EE_KEY_PAD_SIZE; ++i) {
+        buffer[i] = buffer[i % buffer_len];
+    }
 
     key->key = buffer;
     key->length = buffer_len;
@@ -61,40 +68,60 @@ ee_sdata_decrypt(ee_sdata_t *sdata, ee_key_t *key)
 static void
 ee_sdata_common_crypt_s(ee_sdata_t *sdata, ee_key_t *key)
 {
-    ee_size_t bytes_number = EE_EVAL_BYTES_NUMBER(sdata->bits_number);
+    ee_size_t bytes_number = sdata->bits_number / EE_BITS_IN_BYTE;
+    ee_size_t rem = sdata->bits_number % EE_BITS_IN_BYTE;
+    ee_size_t period = key->length * EE_BITS_IN_BYTE;
+    ee_size_t pos;
+    ee_size_t i = 0;
+
+    if (0 == period) {
+        return;
+    }
 
-    for (ee_size_t i = 0; i < bytes_number; ++i) {
-        ee_size_t bits_number = EE_BITS_IN_BYTE;
-        if (i == bytes_number - 1) {
-            bits_number = sdata->bits_number - EE_BITS_IN_BYTE * i;
+    pos = key->bit_info.current_byte * EE_BITS_IN_BYTE
+            + (EE_BITS_IN_BYTE - 1 - key->bit_info.current_bit);
+    for (; i + sizeof(uint64_t) <= bytes_number; i += sizeof(uint64_t)) {
+        uint64_t word = ee_key_word_at_s(key, pos);
+        for (ee_size_t j = sizeof(uint64_t); j > 0; --j) {
+            sdata->bytes[i + j - 1] ^= (ee_byte_t)word;
+            word >>= EE_BITS_IN_BYTE;
         }
 
-        ee_byte_t key_byte = ee_key_extract_next_byte_s(key, bits_number);
-        sdata->bytes[i] ^= key_byte;
+        pos = (pos + sizeof(uint64_t) * EE_BITS_IN_BYTE) % period;
     }
-}
 
-static ee_byte_t
-ee_key_extract_next_byte_s(ee_key_t *key, ee_size_t bits_number) {
-    ee_byte_t byte = 0;
+    for (; i < bytes_number; ++i) {
+        sdata->bytes[i] ^= (ee_byte_t)(ee_key_word_at_s(key, pos)
+                >> (sizeof(uint64_t) - 1) * EE_BITS_IN_BYTE);
+        pos = (pos + EE_BITS_IN_BYTE) % period;
+    }
 
-    for (ee_size_t i = bits_number; i > 0; --i) {
-        byte |= ee_key_bit_get_s(key) << (i - 1);
-        ee_key_bit_inc_s(key);
+    if (0 != rem) {
+        sdata->bytes[i] ^= (ee_byte_t)(ee_key_word_at_s(key, pos)
+                >> (sizeof(uint64_t) * EE_BITS_IN_BYTE - rem));
+        pos = (pos + rem) % period;
     }
 
-    return byte;
+    key->bit_info.current_byte = pos / EE_BITS_IN_BYTE;
+    key->bit_info.current_bit = EE_BITS_IN_BYTE - 1 - pos % EE_BITS_IN_BYTE;
 }
 
-static ee_size_t
-ee_key_bit_get_s(ee_key_t *key)
+static uint64_t
+ee_key_word_at_s(ee_key_t *key, ee_size_t pos)
 {
-    return ee_bit_get(key->key[key->bit_info.current_byte],
-            key->bit_info.current_bit);
-}
+    const ee_byte_t *bytes = (const ee_byte_t *)key->key
+            + pos / EE_BITS_IN_BYTE;
+    ee_size_t shift = pos % EE_BITS_IN_BYTE;
+    uint64_t word = 0;
 
-static void
-ee_key_bit_inc_s(ee_key_t *key)
-{
-    ee_bit_info_ms_inc_cyc(&(key->bit_info), key->length);
+    for (ee_size_t i = 0; i < sizeof(word); ++i) {
+        word = (word << EE_BITS_IN_BYTE) | bytes[i];
+    }
+
+    if (0 != shift) {
+        word = (word << shift)
+                | (bytes[sizeof(word)] >> (EE_BITS_IN_BYTE - shift));
+    }
+
+    return word;
 }
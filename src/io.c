@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "io.h"
 
 #include "util.h"
+#include "profile.h"
 
 #define EE_IO_BUFFER_SIZE (64 * 1024)
 
@@ -27,6 +29,17 @@ ee_file_write_not_aligned_s(ee_file_t *file, ee_byte_t *bytes, ee_size_t count);
 static ee_size_t
 ee_file_avail_bits_number_eval_s(ee_file_t *file);
 
+static uint64_t
+ee_file_word_load_s(const ee_byte_t *bytes);
+static void
+ee_file_word_store_s(ee_byte_t *bytes, uint64_t word);
+static void
+ee_file_shift_out_s(ee_byte_t *bytes, const ee_byte_t *buffer,
+        ee_size_t count, ee_size_t shift);
+static void
+ee_file_shift_in_s(ee_byte_t *buffer, const ee_byte_t *bytes,
+        ee_size_t count, ee_size_t shift);
+
 static void
 ee_file_copy_byte_bits_to_s(ee_byte_t *byte, ee_int_t start, ee_int_t end,
         ee_file_t *file);
@@ -72,6 +85,7 @@ ee_file_open(ee_file_t *file, const ee_char_t *name, ee_int_t mode)
 
     file->mode = mode;
     file->buffer_size = ((EE_MODE_WRITE == mode) ? EE_IO_BUFFER_SIZE : 0);
+    file->offset = 0;
     file->bit_info.current_bit = EE_BITS_IN_BYTE - 1;
     file->bit_info.current_byte = 0;
     file->status = EE_SUCCESS;
@@ -130,6 +144,53 @@ ee_file_flush(ee_file_t *file)
     return file->status;
 }
 
+ee_int_t
+ee_file_rewind(ee_file_t *file)
+{
+    if (EE_MODE_READ != file->mode) {
+        file->status = EE_INCORRECT_MODE;
+    } else if (0 != fseek(file->file, 0, SEEK_SET)) {
+        file->status = EE_FILE_READ_FAILURE;
+    } else {
+        file->buffer_size = 0;
+        file->offset = 0;
+        file->bit_info.current_bit = EE_BITS_IN_BYTE - 1;
+        file->bit_info.current_byte = 0;
+        file->status = EE_SUCCESS;
+    }
+
+    return file->status;
+}
+
+void
+ee_file_tell(ee_file_t *file, ee_file_pos_t *pos)
+{
+    pos->byte = file->offset + file->bit_info.current_byte;
+    pos->bit = file->bit_info.current_bit;
+}
+
+ee_int_t
+ee_file_seek(ee_file_t *file, ee_file_pos_t *pos)
+{
+    file->status = EE_SUCCESS;
+    if (EE_MODE_READ != file->mode) {
+        file->status = EE_INCORRECT_MODE;
+    } else if (pos->byte >= file->offset
+            && pos->byte < file->offset + (long)file->buffer_size) {
+        file->bit_info.current_byte = pos->byte - file->offset;
+        file->bit_info.current_bit = pos->bit;
+    } else if (0 != fseek(file->file, pos->byte, SEEK_SET)) {
+        file->status = EE_FILE_READ_FAILURE;
+    } else {
+        file->offset = pos->byte;
+        file->buffer_size = 0;
+        ee_file_buffer_fill_s(file);
+        file->bit_info.current_bit = pos->bit;
+    }
+
+    return file->status;
+}
+
 ee_size_t
 ee_file_read(ee_byte_t *bytes, ee_size_t number, ee_file_t *file)
 {
@@ -279,19 +340,62 @@ ee_int_t
 ee_file_read_sdata(ee_sdata_t *sdata, ee_size_t bits_number, ee_file_t *file)
 {
     ee_int_t status;
-    ee_size_t bytes_number = EE_EVAL_BYTES_NUMBER(bits_number);
 
-    sdata->bits_number = bits_number;
-    sdata->bytes = calloc(bytes_number, sizeof(*(sdata->bytes)));
-    if (NULL == sdata->bytes) {
-        status = EE_ALLOC_FAILURE;
-    } else {
+    status = ee_sdata_reserve(sdata, bits_number);
+    if (EE_SUCCESS == status) {
         status = ee_file_read_bits(sdata->bytes, sdata->bits_number, file);
     }
 
     return status;
 }
 
+/*
+ * Reads bits_number more bits past the ones sdata already holds, as if the
+ * whole record were read at once: the bits of a partial last byte move up
+ * to make room for the ones that follow.
+ */
+ee_int_t
+ee_file_read_sdata_append(ee_sdata_t *sdata, ee_size_t bits_number,
+        ee_file_t *file)
+{
+    ee_int_t status;
+
+    ee_size_t bytes_number = sdata->bits_number / EE_BITS_IN_BYTE;
+    ee_size_t rem = sdata->bits_number % EE_BITS_IN_BYTE;
+    ee_size_t head = 0;
+
+    status = ee_sdata_grow(sdata, sdata->bits_number + bits_number);
+    if (EE_SUCCESS != status) {
+        goto read_error;
+    }
+
+    if (0 != rem && 0 != bits_number) {
+        ee_byte_t byte;
+
+        head = EE_BITS_IN_BYTE - rem;
+        if (head > bits_number) {
+            head = bits_number;
+        }
+
+        status = ee_file_read_byte_bits(&byte, head, file);
+        if (EE_SUCCESS != status) {
+            goto read_error;
+        }
+
+        sdata->bytes[bytes_number] = (ee_byte_t)((sdata->bytes[bytes_number]
+                << head) | byte);
+        bytes_number += 1;
+    }
+
+    if (bits_number > head) {
+        status = ee_file_read_bits(sdata->bytes + bytes_number,
+                bits_number - head, file);
+    }
+
+read_error:
+    return status;
+}
+
 ee_int_t
 ee_file_write_sdata(ee_file_t *file, ee_sdata_t *sdata)
 {
@@ -335,14 +439,17 @@ ee_file_read_message(ee_message_t *message, ee_file_t *file)
     message->length = 0;
 
     do {
-        p = realloc(message->chars, capacity + EE_IO_BUFFER_SIZE);
-        if (NULL == p) {
-            return EE_ALLOC_FAILURE;
+        if (message->length + EE_IO_BUFFER_SIZE > capacity) {
+            capacity = 2 * capacity + EE_IO_BUFFER_SIZE;
+            p = realloc(message->chars, capacity);
+            if (NULL == p) {
+                return EE_ALLOC_FAILURE;
+            }
+
+            message->chars = p;
         }
 
-        message->chars = p;
-        p = message->chars + capacity;
-        capacity += EE_IO_BUFFER_SIZE;
+        p = message->chars + message->length;
 
         ee_size_t rc = ee_file_read(p, EE_IO_BUFFER_SIZE, file);
         message->length += rc;
@@ -395,8 +502,10 @@ ee_file_smode_build_s(ee_int_t mode)
 static void
 ee_file_buffer_fill_s(ee_file_t *file)
 {
+    file->offset += file->buffer_size;
     file->buffer_size = fread(file->buffer, sizeof(ee_byte_t),
             EE_IO_BUFFER_SIZE, file->file);
+    ee_profile_count(EE_PROFILE_BYTES_READ, file->buffer_size);
     file->bit_info.current_bit = EE_BITS_IN_BYTE - 1;
     file->bit_info.current_byte = 0;
 }
@@ -448,12 +557,32 @@ end:
 static ee_size_t
 ee_file_read_not_aligned_s(ee_byte_t *bytes, ee_size_t count, ee_file_t *file)
 {
-    ee_size_t i;
+    ee_size_t i = 0;
+
+    while (i < count) {
+        ee_size_t cby = file->bit_info.current_byte;
+        ee_size_t shift = EE_BITS_IN_BYTE - 1 - file->bit_info.current_bit;
+        ee_size_t n = 0;
+
+        if (cby + 1 < file->buffer_size) {
+            n = file->buffer_size - cby - 1;
+            if (n > count - i) {
+                n = count - i;
+            }
+        }
+
+        if (0 != n) {
+            ee_file_shift_out_s(bytes + i, file->buffer + cby, n, shift);
+            file->bit_info.current_byte += n;
+            i += n;
+        } else {
+            file->status = ee_file_read_byte_bits(bytes + i, EE_BITS_IN_BYTE,
+                    file);
+            if (EE_SUCCESS != file->status) {
+                break;
+            }
 
-    for (i = 0; i < count; ++i) {
-        file->status = ee_file_read_byte_bits(bytes + i, EE_BITS_IN_BYTE, file);
-        if (EE_SUCCESS != file->status) {
-            break;
+            i += 1;
         }
     }
 
@@ -489,12 +618,32 @@ ee_file_write_aligned_s(ee_file_t *file, ee_byte_t *bytes, ee_size_t count)
 static ee_size_t
 ee_file_write_not_aligned_s(ee_file_t *file, ee_byte_t *bytes, ee_size_t count)
 {
-    ee_size_t i;
+    ee_size_t i = 0;
+
+    while (i < count) {
+        ee_size_t cby = file->bit_info.current_byte;
+        ee_size_t shift = EE_BITS_IN_BYTE - 1 - file->bit_info.current_bit;
+        ee_size_t n = 0;
 
-    for (i = 0; i < count; ++i) {
-        file->status = ee_file_write_byte_bits(file, bytes[i], EE_BITS_IN_BYTE);
-        if (EE_SUCCESS != file->status) {
-            break;
+        if (cby + 1 < file->buffer_size) {
+            n = file->buffer_size - cby - 1;
+            if (n > count - i) {
+                n = count - i;
+            }
+        }
+
+        if (0 != n) {
+            ee_file_shift_in_s(file->buffer + cby, bytes + i, n, shift);
+            file->bit_info.current_byte += n;
+            i += n;
+        } else {
+            file->status = ee_file_write_byte_bits(file, bytes[i],
+                    EE_BITS_IN_BYTE);
+            if (EE_SUCCESS != file->status) {
+                break;
+            }
+
+            i += 1;
         }
     }
 
@@ -511,6 +660,70 @@ ee_file_avail_bits_number_eval_s(ee_file_t *file)
     return (bs - cby) * EE_BITS_IN_BYTE - (EE_BITS_IN_BYTE - (cbi + 1));
 }
 
+static uint64_t
+ee_file_word_load_s(const ee_byte_t *bytes)
+{
+    uint64_t word = 0;
+
+    for (ee_size_t i = 0; i < sizeof(word); ++i) {
+        word = (word << EE_BITS_IN_BYTE) | bytes[i];
+    }
+
+    return word;
+}
+
+static void
+ee_file_word_store_s(ee_byte_t *bytes, uint64_t word)
+{
+    for (ee_size_t i = sizeof(word); i > 0; --i) {
+        bytes[i - 1] = (ee_byte_t)word;
+        word >>= EE_BITS_IN_BYTE;
+    }
+}
+
+static void
+ee_file_shift_out_s(ee_byte_t *bytes, const ee_byte_t *buffer,
+        ee_size_t count, ee_size_t shift)
+{
+    ee_size_t i = 0;
+    ee_size_t rshift = EE_BITS_IN_BYTE - shift;
+
+    for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t)) {
+        uint64_t word = ee_file_word_load_s(buffer + i);
+        word = (word << shift) | (buffer[i + sizeof(uint64_t)] >> rshift);
+        ee_file_word_store_s(bytes + i, word);
+    }
+
+    for (; i < count; ++i) {
+        bytes[i] = (ee_byte_t)((buffer[i] << shift) | (buffer[i + 1] >> rshift));
+    }
+}
+
+static void
+ee_file_shift_in_s(ee_byte_t *buffer, const ee_byte_t *bytes,
+        ee_size_t count, ee_size_t shift)
+{
+    ee_size_t i = 0;
+    ee_size_t rshift = EE_BITS_IN_BYTE - shift;
+    ee_byte_t mask = (1 << shift) - 1;
+    ee_byte_t carry = buffer[0] >> rshift;
+
+    for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t)) {
+        uint64_t word = ee_file_word_load_s(bytes + i);
+        ee_file_word_store_s(buffer + i,
+                ((uint64_t)carry << (64 - shift)) | (word >> shift));
+        carry = word & mask;
+    }
+
+    for (; i < count; ++i) {
+        buffer[i] = (ee_byte_t)((carry << rshift) | (bytes[i] >> shift));
+        carry = bytes[i] & mask;
+    }
+
+    buffer[count] = (ee_byte_t)((carry << rshift)
+            | (buffer[count] & ((1 << rshift) - 1)));
+}
+
 static void
 ee_file_copy_byte_bits_to_s(ee_byte_t *byte, ee_int_t start, ee_int_t end,
         ee_file_t *file)
@@ -17,10 +17,16 @@ typedef struct ee_file_s {
     ee_int_t mode;
     ee_byte_t *buffer;
     ee_size_t buffer_size;
+    long offset;
     ee_bit_info_t bit_info;
     ee_int_t status;
 } ee_file_t;
 
+typedef struct ee_file_pos_s {
+    long byte;
+    ee_size_t bit;
+} ee_file_pos_t;
+
 ee_int_t
 ee_file_open(ee_file_t *file, const ee_char_t *name, ee_int_t mode);
 void
@@ -31,6 +37,12 @@ ee_file_last_status(ee_file_t *file);
 
 ee_int_t
 ee_file_flush(ee_file_t *file);
+ee_int_t
+ee_file_rewind(ee_file_t *file);
+void
+ee_file_tell(ee_file_t *file, ee_file_pos_t *pos);
+ee_int_t
+ee_file_seek(ee_file_t *file, ee_file_pos_t *pos);
 
 ee_size_t
 ee_file_read(ee_byte_t *bytes, ee_size_t number, ee_file_t *file);
@@ -50,6 +62,9 @@ ee_file_write_byte_bits(ee_file_t *file, ee_byte_t byte, ee_size_t bits_number);
 ee_int_t
 ee_file_read_sdata(ee_sdata_t *sdata, ee_size_t bits_number, ee_file_t *file);
 ee_int_t
+ee_file_read_sdata_append(ee_sdata_t *sdata, ee_size_t bits_number,
+        ee_file_t *file);
+ee_int_t
 ee_file_write_sdata(ee_file_t *file, ee_sdata_t *sdata);
 
 ee_int_t
@@ -1,31 +1,180 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <gmp.h>
 
 #include "numeration.h"
 
-typedef struct ee_z_item_s {
-    mpz_t item;
-    ee_bool_t init;
-} ee_z_item_t;
+#include "util.h"
+
+/*
+ * Every rho, theta and delta of a block of n symbols is at most n!, and the
+ * restored rho * eta stays below 2 * n!, so blocks up to EE_WORD_LENGTH_MAX
+ * symbols are numerated in machine words.
+ */
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 ee_word_t;
+#define EE_WORD_LENGTH_MAX 33
+#else
+typedef uint64_t ee_word_t;
+#define EE_WORD_LENGTH_MAX 20
+#endif
+
+/*
+ * One representation of the numbers of ee_block_restore_walk_s, mpz_t or,
+ * from ctx->limbs_level down, ee_limbs_t: the node function the walk goes
+ * down with and the arithmetic of a node, given the node.
+ */
+typedef void ee_restore_node_t(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t level,
+        ee_size_t index, ee_bool_t need_rho);
+typedef void ee_restore_step_t(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index);
+typedef void ee_restore_leaf_t(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_size_t sym_idx);
+
+typedef struct ee_restore_ops_s {
+    ee_restore_node_t *node;
+    ee_restore_step_t *pad;
+    ee_restore_step_t *pad_up;
+    ee_restore_step_t *split;
+    ee_restore_step_t *carry;
+    ee_restore_step_t *join;
+    ee_restore_leaf_t *leaf;
+} ee_restore_ops_t;
 
-typedef struct ee_rt_item_s {
-    mpz_t rho;
-    mpz_t theta;
-} ee_rt_item_t;
+static void
+ee_eval_rtd0_s(ee_numeration_ctx_t *ctx, ee_limbs_t *rho, ee_limbs_t *theta,
+        ee_block_t *block, ee_size_t begin, ee_size_t length);
+static void
+ee_eval_rtd_limbs_s(ee_numeration_ctx_t *ctx, ee_limbs_tree_t *delta,
+        ee_block_t *block, ee_statistics_t *statistics);
+static void
+ee_eval_rtd_s(ee_numeration_ctx_t *ctx, mpz_t **rho, mpz_t **theta,
+        mpz_t **delta, ee_block_t *block);
 
+static ee_size_t
+ee_tree_cols_s(ee_size_t length, ee_size_t level);
+static ee_delta_cache_item_t *
+ee_delta_cache_get_s(ee_numeration_ctx_t *ctx, ee_size_t length);
+static void
+ee_delta_cache_complete_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *item);
 static void
-ee_eval_rtd0_s(mpz_t *rho, mpz_t *theta, mpz_t *delta, ee_block_t *block,
+ee_eval_rho_stats_s(ee_numeration_ctx_t *ctx, mpz_t rho,
         ee_statistics_t *statistics);
+
+static ee_size_t
+ee_delta_set_bit_s(mpz_t delta, ee_size_t count);
+static ee_size_t
+ee_limb_popcount_s(mp_limb_t limb);
+
+static inline void
+ee_block_restore_walk_s(ee_numeration_ctx_t *ctx, const ee_restore_ops_t *ops,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t level,
+        ee_size_t index, ee_bool_t need_rho);
+static ee_restore_node_t ee_block_restore_node_s;
+static ee_restore_node_t ee_block_restore_limbs_node_s;
+static ee_bool_t
+ee_block_restore_limbs_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t index,
+        ee_bool_t need_rho);
+static ee_restore_step_t ee_block_restore_pad_s;
+static ee_restore_step_t ee_block_restore_pad_up_s;
+static ee_restore_step_t ee_block_restore_split_s;
+static ee_restore_step_t ee_block_restore_carry_s;
+static ee_restore_step_t ee_block_restore_join_s;
+static ee_restore_leaf_t ee_block_restore_symbol_s;
+static ee_restore_step_t ee_block_restore_limbs_pad_s;
+static ee_restore_step_t ee_block_restore_limbs_pad_up_s;
+static ee_restore_step_t ee_block_restore_limbs_split_s;
+static ee_restore_step_t ee_block_restore_limbs_carry_s;
+static ee_restore_step_t ee_block_restore_limbs_join_s;
+static ee_restore_leaf_t ee_block_restore_limbs_symbol_s;
+static ee_limbs_t *
+ee_block_restore_rho_limbs_s(ee_numeration_ctx_t *ctx, ee_size_t level,
+        ee_size_t index);
+static ee_int_t
+ee_block_restore_char_s(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_size_t sym_idx, ee_int_t *less);
+static ee_size_t
+ee_thetas_init_s(ee_numeration_ctx_t *ctx, ee_statistics_t *statistics);
+static ee_size_t
+ee_thetas_find_s(ee_int_t *thetas, ee_int_t *less);
+static void
+ee_thetas_dec_s(ee_numeration_ctx_t *ctx, ee_size_t ch);
+
+static void
+ee_eval_rtd_word_s(ee_block_t *block, ee_word_t *rho, ee_word_t *theta,
+        ee_word_t *delta);
+static void
+ee_block_restore_word_s(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_word_t z);
+static ee_bool_t
+ee_word_fits_s(mpz_t mpz);
+static ee_word_t
+ee_word_get_s(mpz_t mpz);
+static void
+ee_word_set_s(mpz_t mpz, ee_word_t word);
+
+static void
+ee_limbs_set_ui_s(ee_limbs_t *r, ee_limb_t value);
+static void
+ee_limbs_add_s(ee_limbs_t *r, const ee_limbs_t *a);
+static void
+ee_limbs_mul_s(ee_limbs_t *r, const ee_limbs_t *a, const ee_limbs_t *b);
+static void
+ee_limbs_addmul_s(ee_limbs_t *r, const ee_limbs_t *a, const ee_limbs_t *b);
 static void
-ee_eval_rtd_s(mpz_t *rho, mpz_t *theta, mpz_t *delta, ee_block_t *block);
+ee_limbs_tdiv_qr_s(ee_limbs_t *q, ee_limbs_t *r, const ee_limbs_t *n,
+        const ee_limbs_t *d);
+static void
+ee_limbs_normalize_s(ee_limbs_t *r);
+static void
+ee_limbs_get_mpz_s(mpz_t mpz, const ee_limbs_t *a);
+static void
+ee_limbs_set_mpz_s(ee_limbs_t *r, mpz_t mpz);
+static ee_size_t
+ee_limbs_width_s(ee_size_t sigma, ee_size_t level);
+static void
+ee_limbs_tree_get_s(ee_numeration_ctx_t *ctx, ee_limbs_t *r,
+        const ee_limbs_tree_t *tree, ee_size_t level, ee_size_t index);
+static void
+ee_limbs_tree_set_s(ee_numeration_ctx_t *ctx, ee_limbs_tree_t *tree,
+        ee_size_t level, ee_size_t index, const ee_limbs_t *a);
 
+static ee_size_t
+ee_eval_reserve_bits_s(ee_size_t length, ee_size_t level);
+static ee_size_t
+ee_limbs_level_s(ee_size_t sigma);
+static void
+ee_numeration_ctx_reserve_s(ee_numeration_ctx_t *ctx, ee_size_t length);
+static ee_int_t
+ee_numeration_ctx_tree_alloc_s(ee_numeration_ctx_t *ctx, ee_mpz_tree_t *tree);
 static void
-ee_eval_z_s(ee_z_item_t **z, ee_int_t *indexes, ee_size_t sym_idx,
-        ee_block_t *block, ee_rt_item_t **rt, mpz_t **delta);
+ee_numeration_ctx_tree_free_s(ee_numeration_ctx_t *ctx, ee_mpz_tree_t *tree);
 static void
-ee_block_restore_symbol_s(ee_block_t *block, ee_size_t sym_idx,
-        ee_rt_item_t **rt, mpz_t **delta, ee_int_t *thetas, ee_z_item_t **z);
+ee_mpz_tree_reserve_s(ee_mpz_tree_t *tree, ee_size_t from, ee_size_t to,
+        ee_size_t length);
+static ee_int_t
+ee_numeration_ctx_limbs_tree_alloc_s(ee_numeration_ctx_t *ctx,
+        ee_limbs_tree_t *tree);
+static void
+ee_numeration_ctx_limbs_tree_free_s(ee_limbs_tree_t *tree);
+
+static const ee_restore_ops_t ee_restore_mpz_ops_s = {
+    ee_block_restore_node_s,
+    ee_block_restore_pad_s, ee_block_restore_pad_up_s,
+    ee_block_restore_split_s, ee_block_restore_carry_s,
+    ee_block_restore_join_s, ee_block_restore_symbol_s
+};
+
+static const ee_restore_ops_t ee_restore_limbs_ops_s = {
+    ee_block_restore_limbs_node_s,
+    ee_block_restore_limbs_pad_s, ee_block_restore_limbs_pad_up_s,
+    ee_block_restore_limbs_split_s, ee_block_restore_limbs_carry_s,
+    ee_block_restore_limbs_join_s, ee_block_restore_limbs_symbol_s
+};
 
 void
 ee_number_init(ee_number_t *number)
@@ -58,536 +207,1576 @@ ee_subnumber_deinit(ee_subnumber_t *subnumber)
 }
 
 ee_int_t
-ee_number_eval(ee_number_t *number, ee_block_t *block,
-        ee_statistics_t *statistics)
+ee_numeration_ctx_init(ee_numeration_ctx_t *ctx, ee_size_t sigma)
 {
-    ee_int_t status = EE_SUCCESS;
-    mpz_t *rho = NULL;
-    mpz_t *theta = NULL;
-    mpz_t *delta = NULL;
+    ee_size_t zrows = sigma + 1;
+    ee_size_t lrows;
 
-    rho = calloc(block->size, sizeof(*rho));
-    if (NULL == rho) {
-        status = EE_ALLOC_FAILURE;
-        goto rho_calloc_error;
+    ee_memset(ctx, 0, sizeof(*ctx));
+    ctx->sigma = sigma;
+    ctx->size = 1 << sigma;
+    ctx->limbs_level = ee_limbs_level_s(sigma);
+    lrows = ctx->limbs_level + 1;
+
+    mpz_init(ctx->tmp1);
+    mpz_init(ctx->tmp2);
+
+    if (EE_SUCCESS != ee_numeration_ctx_tree_alloc_s(ctx, &(ctx->rho))) {
+        goto alloc_error;
     }
 
-    theta = calloc(block->size, sizeof(*theta));
-    if (NULL == theta) {
-        status = EE_ALLOC_FAILURE;
-        goto theta_calloc_error;
+    if (EE_SUCCESS != ee_numeration_ctx_tree_alloc_s(ctx, &(ctx->theta))) {
+        goto alloc_error;
     }
 
-    delta = calloc(block->size, sizeof(*delta));
-    if (NULL == delta) {
-        status = EE_ALLOC_FAILURE;
-        goto delta_calloc_error;
+    ctx->rho_limbs = calloc((ee_size_t)2 << ctx->limbs_level,
+            sizeof(*(ctx->rho_limbs)));
+    if (NULL == ctx->rho_limbs) {
+        goto alloc_error;
     }
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        mpz_init(rho[i]);
-        mpz_init(theta[i]);
-        mpz_init(delta[i]);
+    ctx->theta_limbs = calloc((ee_size_t)2 << ctx->limbs_level,
+            sizeof(*(ctx->theta_limbs)));
+    if (NULL == ctx->theta_limbs) {
+        goto alloc_error;
     }
 
-    ee_eval_rtd0_s(rho, theta, delta, block, statistics);
-    ee_eval_rtd_s(rho, theta, delta, block);
+    ctx->z_limbs = calloc(lrows, sizeof(*(ctx->z_limbs)));
+    if (NULL == ctx->z_limbs) {
+        goto alloc_error;
+    }
 
-    mpz_cdiv_q(number->eta, theta[0], rho[0]);
-    mpz_cdiv_q(number->delta, delta[0], rho[0]);
+    ctx->rem_limbs = calloc(lrows, sizeof(*(ctx->rem_limbs)));
+    if (NULL == ctx->rem_limbs) {
+        goto alloc_error;
+    }
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        mpz_clear(rho[i]);
-        mpz_clear(theta[i]);
-        mpz_clear(delta[i]);
+    ctx->excess_limbs = calloc(lrows, sizeof(*(ctx->excess_limbs)));
+    if (NULL == ctx->excess_limbs) {
+        goto alloc_error;
     }
 
-    free(delta);
-delta_calloc_error:
-    free(theta);
-theta_calloc_error:
-    free(rho);
-rho_calloc_error:
-    return status;
-}
+    ctx->delta_limbs = calloc(lrows, sizeof(*(ctx->delta_limbs)));
+    if (NULL == ctx->delta_limbs) {
+        goto alloc_error;
+    }
 
-void
-ee_subnumber_eval(ee_subnumber_t *subnumber, ee_number_t *number)
-{
-    ee_size_t bit_idx;
-    mpz_t diff = EE_MPZ_NULL;
+    ctx->thetas = calloc(EE_ALPHABET_SIZE + 1, sizeof(*(ctx->thetas)));
+    if (NULL == ctx->thetas) {
+        goto alloc_error;
+    }
 
-    mpz_init(diff);
+    ctx->counts = calloc(EE_ALPHABET_SIZE, sizeof(*(ctx->counts)));
+    if (NULL == ctx->counts) {
+        goto alloc_error;
+    }
 
-    mpz_set(subnumber->subnum, number->eta);
-    subnumber->subset = 0;
-    for (bit_idx = mpz_sizeinbase(number->delta, 2); 0 != bit_idx; --bit_idx) {
-        if (0 != mpz_tstbit(number->delta, bit_idx)) {
-            mpz_set_ui(diff, 1);
-            mpz_mul_2exp(diff, diff, bit_idx);
-            if (mpz_cmp(subnumber->subnum, diff) >= 0) {
-                mpz_sub(subnumber->subnum, subnumber->subnum, diff);
-                subnumber->subset += 1;
-            } else {
-                break;
-            }
+    ctx->z = calloc(zrows, sizeof(*(ctx->z)));
+    if (NULL == ctx->z) {
+        goto alloc_error;
+    }
+
+    for (ee_size_t i = 0; i < zrows; ++i) {
+        mpz_init(ctx->z[i]);
+    }
+
+    ctx->rem = calloc(zrows, sizeof(*(ctx->rem)));
+    if (NULL == ctx->rem) {
+        goto alloc_error;
+    }
+
+    for (ee_size_t i = 0; i < zrows; ++i) {
+        mpz_init(ctx->rem[i]);
+    }
+
+    ctx->excess = calloc(zrows, sizeof(*(ctx->excess)));
+    if (NULL == ctx->excess) {
+        goto alloc_error;
+    }
+
+    for (ee_size_t i = 0; i < zrows; ++i) {
+        mpz_init(ctx->excess[i]);
+    }
+
+    for (ee_size_t i = 0; i < EE_DELTA_CACHE_SIZE; ++i) {
+        if (EE_SUCCESS != ee_numeration_ctx_tree_alloc_s(ctx,
+                &(ctx->delta_cache[i].tree))) {
+            goto alloc_error;
+        }
+
+        if (EE_SUCCESS != ee_numeration_ctx_limbs_tree_alloc_s(ctx,
+                &(ctx->delta_cache[i].limbs))) {
+            goto alloc_error;
         }
     }
 
-    subnumber->subnum_bit_length = bit_idx;
+    ctx->factorials_count = ((ctx->size < EE_FACTORIALS_MAX)
+            ? ctx->size : EE_FACTORIALS_MAX) + 1;
+    ctx->factorials = calloc(ctx->factorials_count,
+            sizeof(*(ctx->factorials)));
+    if (NULL == ctx->factorials) {
+        goto alloc_error;
+    }
+
+    mpz_init_set_ui(ctx->factorials[0], 1);
+    for (ee_size_t i = 1; i < ctx->factorials_count; ++i) {
+        mpz_init(ctx->factorials[i]);
+        mpz_mul_ui(ctx->factorials[i], ctx->factorials[i - 1], i);
+    }
+
+    return EE_SUCCESS;
 
-    mpz_clear(diff);
+alloc_error:
+    ee_numeration_ctx_deinit(ctx);
+    return EE_ALLOC_FAILURE;
 }
 
-ee_int_t
-ee_eval_rho(mpz_t out_rho, ee_block_t *block, ee_statistics_t *statistics)
+void
+ee_numeration_ctx_deinit(ee_numeration_ctx_t *ctx)
 {
-    ee_int_t status = EE_SUCCESS;
-    mpz_t *rho = NULL;
+    ee_size_t zrows = ctx->sigma + 1;
+
+    if (NULL != ctx->factorials) {
+        for (ee_size_t i = 0; i < ctx->factorials_count; ++i) {
+            mpz_clear(ctx->factorials[i]);
+        }
 
-    rho = calloc(block->size, sizeof(*rho));
-    if (NULL == rho) {
-        status = EE_ALLOC_FAILURE;
-        goto rho_calloc_error;
+        free(ctx->factorials);
     }
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        mpz_init(rho[i]);
+    for (ee_size_t i = 0; i < EE_DELTA_CACHE_SIZE; ++i) {
+        ee_numeration_ctx_limbs_tree_free_s(&(ctx->delta_cache[i].limbs));
+        ee_numeration_ctx_tree_free_s(ctx, &(ctx->delta_cache[i].tree));
     }
 
-    ee_eval_rtd0_s(rho, NULL, NULL, block, statistics);
-    ee_eval_rtd_s(rho, NULL, NULL, block);
+    if (NULL != ctx->excess) {
+        for (ee_size_t i = 0; i < zrows; ++i) {
+            mpz_clear(ctx->excess[i]);
+        }
+
+        free(ctx->excess);
+    }
 
-    mpz_set(out_rho, rho[0]);
+    if (NULL != ctx->rem) {
+        for (ee_size_t i = 0; i < zrows; ++i) {
+            mpz_clear(ctx->rem[i]);
+        }
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        mpz_clear(rho[i]);
+        free(ctx->rem);
     }
 
-    free(rho);
-rho_calloc_error:
-    return status;
+    if (NULL != ctx->z) {
+        for (ee_size_t i = 0; i < zrows; ++i) {
+            mpz_clear(ctx->z[i]);
+        }
+
+        free(ctx->z);
+    }
+
+    free(ctx->counts);
+    free(ctx->thetas);
+
+    free(ctx->delta_limbs);
+    free(ctx->excess_limbs);
+    free(ctx->rem_limbs);
+    free(ctx->z_limbs);
+    free(ctx->theta_limbs);
+    free(ctx->rho_limbs);
+
+    ee_numeration_ctx_tree_free_s(ctx, &(ctx->theta));
+    ee_numeration_ctx_tree_free_s(ctx, &(ctx->rho));
+
+    mpz_clear(ctx->tmp2);
+    mpz_clear(ctx->tmp1);
+
+    ee_memset(ctx, 0, sizeof(*ctx));
 }
 
-ee_int_t
-ee_eval_delta(mpz_t out_delta, mpz_t rho, ee_block_t *block,
-        ee_statistics_t *statistics)
+void
+ee_number_eval(ee_numeration_ctx_t *ctx, ee_number_t *number,
+        ee_block_t *block, ee_statistics_t *statistics)
 {
-    ee_int_t status = EE_SUCCESS;
-    mpz_t *delta = NULL;
-
-    delta = calloc(block->size, sizeof(*delta));
-    if (NULL == delta) {
-        status = EE_ALLOC_FAILURE;
-        goto delta_calloc_error;
+    ee_delta_cache_item_t *delta = NULL;
+
+    if (EE_WORD_LENGTH_MAX >= block->length) {
+        ee_word_t rho_w, theta_w, delta_w;
+        ee_eval_rtd_word_s(block, &rho_w, &theta_w, &delta_w);
+        ee_word_set_s(number->eta, (theta_w + rho_w - 1) / rho_w);
+        ee_word_set_s(number->delta, (delta_w + rho_w - 1) / rho_w);
+        return;
     }
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        mpz_init(delta[i]);
+    delta = ee_delta_cache_get_s(ctx, block->length);
+    ee_numeration_ctx_reserve_s(ctx, block->length);
+    ee_mpz_tree_reserve_s(&(ctx->theta), ctx->limbs_level, ctx->sigma,
+            block->length);
+
+    ee_eval_rtd_limbs_s(ctx, &(delta->limbs), block, statistics);
+    ee_eval_rtd_s(ctx, ctx->rho.levels, ctx->theta.levels, delta->tree.levels,
+            block);
+
+    mpz_cdiv_q(number->eta, ctx->theta.levels[block->sigma][0],
+            ctx->rho.levels[block->sigma][0]);
+    mpz_cdiv_q(number->delta, delta->tree.levels[block->sigma][0],
+            ctx->rho.levels[block->sigma][0]);
+}
+
+void
+ee_subnumber_eval(ee_numeration_ctx_t *ctx, ee_subnumber_t *subnumber,
+        ee_number_t *number)
+{
+    ee_size_t bit_idx = 0;
+
+    /*
+     * The powers of two of delta are taken from the top while eta covers
+     * them, that is, down to the highest bit where eta and delta differ.
+     * Bit 0 is never taken.
+     */
+    mpz_xor(ctx->tmp1, number->eta, number->delta);
+    if (0 != mpz_sgn(ctx->tmp1)) {
+        bit_idx = mpz_sizeinbase(ctx->tmp1, 2) - 1;
     }
 
-    ee_eval_rtd0_s(NULL, NULL, delta, block, statistics);
-    ee_eval_rtd_s(NULL, NULL, delta, block);
+    mpz_tdiv_q_2exp(ctx->tmp2, number->delta, bit_idx + 1);
+    subnumber->subset = mpz_popcount(ctx->tmp2);
+    mpz_mul_2exp(ctx->tmp2, ctx->tmp2, bit_idx + 1);
+    mpz_sub(subnumber->subnum, number->eta, ctx->tmp2);
+    subnumber->subnum_bit_length = bit_idx;
+}
 
-    mpz_cdiv_q(out_delta, delta[0], rho);
+/*
+ * Evaluates rho and delta of a block.  rho only depends on the statistics,
+ * so no tree is built for it here; the delta tree is taken from the
+ * context's cache, so ee_block_restore on the same context finds its levels
+ * already built.
+ */
+void
+ee_eval_rho_delta(ee_numeration_ctx_t *ctx, mpz_t out_rho, mpz_t out_delta,
+        ee_block_t *block, ee_statistics_t *statistics)
+{
+    ee_delta_cache_item_t *delta = NULL;
+
+    if (EE_WORD_LENGTH_MAX >= block->length) {
+        ee_word_t rho_w, delta_w;
+        ee_eval_rtd_word_s(block, &rho_w, NULL, &delta_w);
+        ee_word_set_s(out_rho, rho_w);
+        ee_word_set_s(out_delta, (delta_w + rho_w - 1) / rho_w);
+        return;
+    }
+
+    delta = ee_delta_cache_get_s(ctx, block->length);
+    ee_eval_rho_stats_s(ctx, out_rho, statistics);
+    mpz_cdiv_q(out_delta, delta->tree.levels[block->sigma][0], out_rho);
+}
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        mpz_clear(delta[i]);
+void
+ee_eval_rho(ee_numeration_ctx_t *ctx, mpz_t out_rho, ee_block_t *block,
+        ee_statistics_t *statistics)
+{
+    if (EE_WORD_LENGTH_MAX >= block->length) {
+        ee_word_t rho_w;
+        ee_eval_rtd_word_s(block, &rho_w, NULL, NULL);
+        ee_word_set_s(out_rho, rho_w);
+        return;
     }
 
-    free(delta);
-delta_calloc_error:
-    return status;
+    ee_eval_rho_stats_s(ctx, out_rho, statistics);
 }
 
 void
 ee_eval_subnum_bit_length(ee_size_t *subnum_bit_length, mpz_t delta,
         ee_int_t subset)
 {
-    *subnum_bit_length = mpz_sizeinbase(delta, 2);
-    for (ee_size_t i = 0; i <= subset; ++i) {
-        do {
-            *subnum_bit_length -= 1;
-        } while (0 == mpz_tstbit(delta, *subnum_bit_length));
-    }
+    *subnum_bit_length = ee_delta_set_bit_s(delta, subset + 1);
 }
 
 void
-ee_number_restore(ee_number_t *number, mpz_t delta, ee_subnumber_t *subnumber)
+ee_number_restore(ee_numeration_ctx_t *ctx, ee_number_t *number, mpz_t delta,
+        ee_subnumber_t *subnumber)
 {
     ee_size_t bit_idx;
-    mpz_t diff = EE_MPZ_NULL;
 
-    mpz_init(diff);
+    mpz_set(number->delta, delta);
+    if (0 == subnumber->subset) {
+        mpz_set(number->eta, subnumber->subnum);
+        return;
+    }
+
+    bit_idx = ee_delta_set_bit_s(delta, subnumber->subset);
+    mpz_tdiv_q_2exp(ctx->tmp1, delta, bit_idx);
+    mpz_mul_2exp(ctx->tmp1, ctx->tmp1, bit_idx);
+    mpz_add(number->eta, subnumber->subnum, ctx->tmp1);
+}
 
-    bit_idx = mpz_sizeinbase(delta, 2);
-    while (0 == mpz_tstbit(delta, bit_idx)) {
-        bit_idx -= 1;
+void
+ee_block_restore(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_statistics_t *statistics, mpz_t rho, ee_number_t *number)
+{
+    ee_delta_cache_item_t *delta = NULL;
+
+    block->length = ee_thetas_init_s(ctx, statistics);
+    if (EE_WORD_LENGTH_MAX >= block->length
+            && EE_TRUE == ee_word_fits_s(number->eta)) {
+        ee_block_restore_word_s(ctx, block,
+                ee_word_get_s(rho) * ee_word_get_s(number->eta));
+        return;
     }
 
-    mpz_set(number->eta, subnumber->subnum);
-    mpz_set(number->delta, delta);
-    for (ee_size_t i = subnumber->subset; i > 0; --i) {
-        while (0 == mpz_tstbit(delta, bit_idx)) {
-            bit_idx -= 1;
-        }
+    delta = ee_delta_cache_get_s(ctx, block->length);
+    ee_numeration_ctx_reserve_s(ctx, block->length);
+
+    mpz_mul(ctx->z[block->sigma], rho, number->eta);
+    ee_block_restore_node_s(ctx, delta, block, block->sigma, 0, EE_FALSE);
+}
+
+/*
+ * Every number of a node over n symbols of a block of the given length, and
+ * every product of the numbers of its children, is below length^n * 2, and a
+ * node of the level covers at most length symbols, however high it is.
+ */
+static ee_size_t
+ee_eval_reserve_bits_s(ee_size_t length, ee_size_t level)
+{
+    ee_size_t leaves = (ee_size_t)1 << level;
+    ee_size_t bits = 0;
+
+    for (ee_size_t n = length; 0 != n; n >>= 1) {
+        bits += 1;
+    }
 
-        mpz_set_ui(diff, 1);
-        mpz_mul_2exp(diff, diff, bit_idx);
-        mpz_add(number->eta, number->eta, diff);
-        bit_idx -= 1;
+    if (leaves > length) {
+        leaves = length;
     }
 
-    mpz_clear(diff);
+    return leaves * bits + GMP_NUMB_BITS;
 }
 
-ee_int_t
-ee_block_restore(ee_block_t *block, ee_statistics_t *statistics, mpz_t rho,
-        ee_number_t *number)
+/*
+ * Every number of a level i node, and every product of two numbers of its
+ * children, is below 2^(2^i * (sigma + 1)), so this is the highest level
+ * whose products of two numbers from the level below fit in EE_LIMBS_MAX
+ * limbs, whatever limbs their factors are cut into.
+ */
+static ee_size_t
+ee_limbs_level_s(ee_size_t sigma)
 {
-    ee_int_t status = EE_SUCCESS;
-    ee_int_t *thetas = NULL;
-    ee_int_t *indexes = NULL;
-    ee_z_item_t **z = NULL;
-    ee_rt_item_t **rt = NULL;
-    mpz_t **delta;
-    ee_size_t zrows = block->sigma + 1;
+    ee_size_t level = 0;
 
-    thetas = calloc(EE_ALPHABET_SIZE + 1, sizeof(*thetas));
-    if (NULL == thetas) {
-        status = EE_ALLOC_FAILURE;
-        goto thetas_calloc_error;
+    while (level < sigma && ((ee_size_t)1 << (level + 1)) * (sigma + 1)
+            + 2 * EE_LIMB_BITS <= EE_LIMBS_MAX * EE_LIMB_BITS) {
+        level += 1;
     }
 
-    indexes = calloc(block->sigma + 1, sizeof(*indexes));
-    if (NULL == indexes) {
-        status = EE_ALLOC_FAILURE;
-        goto indexes_calloc_error;
+    return level;
+}
+
+/*
+ * Grows the numbers that every block up to length symbols uses, that is the
+ * rows of z, rem and excess and the levels of the rho tree from
+ * ctx->limbs_level up, to the room a block of that length needs, so that the
+ * following blocks do not allocate.
+ */
+static void
+ee_numeration_ctx_reserve_s(ee_numeration_ctx_t *ctx, ee_size_t length)
+{
+    if (length <= ctx->length) {
+        return;
     }
 
-    z = calloc(zrows, sizeof(*z));
-    if (NULL == z) {
-        status = EE_ALLOC_FAILURE;
-        goto z_calloc_error;
+    mpz_realloc2(ctx->tmp1, ee_eval_reserve_bits_s(length, ctx->sigma + 1));
+    mpz_realloc2(ctx->tmp2, ee_eval_reserve_bits_s(length, ctx->sigma + 1));
+    for (ee_size_t i = 0; i <= ctx->sigma; ++i) {
+        mpz_realloc2(ctx->z[i], ee_eval_reserve_bits_s(length, i + 1));
+        mpz_realloc2(ctx->rem[i], ee_eval_reserve_bits_s(length, i + 1));
+        mpz_realloc2(ctx->excess[i], ee_eval_reserve_bits_s(length, i));
     }
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        z[i] = calloc(block->size >> i, sizeof(**z));
-        if (NULL == z[i]) {
-            status = EE_ALLOC_FAILURE;
-            goto z_i_calloc_error;
-        }
+
+    ee_mpz_tree_reserve_s(&(ctx->rho), ctx->limbs_level, ctx->sigma, length);
+    ctx->length = length;
+}
+
+/*
+ * Level i of a tree holds size >> i items, and all 2 * size - 1 of them follow
+ * the level pointers and the initialized counts in a single block, leaves
+ * first.  None of them is initialized here, so the pages of the items that
+ * no block reaches are never touched.
+ */
+static ee_int_t
+ee_numeration_ctx_tree_alloc_s(ee_numeration_ctx_t *ctx, ee_mpz_tree_t *tree)
+{
+    ee_size_t rows = ctx->sigma + 1;
+    ee_size_t offset = 0;
+
+    tree->levels = calloc(1, rows * sizeof(*(tree->levels))
+            + rows * sizeof(*(tree->cols))
+            + (2 * ctx->size - 1) * sizeof(*(tree->items)));
+    if (NULL == tree->levels) {
+        tree->cols = NULL;
+        tree->items = NULL;
+        return EE_ALLOC_FAILURE;
     }
 
-    rt = calloc(block->sigma, sizeof(*rt));
-    if (NULL == rt) {
-        status = EE_ALLOC_FAILURE;
-        goto rt_calloc_error;
+    tree->cols = (ee_size_t *)(tree->levels + rows);
+    tree->items = (mpz_t *)(tree->cols + rows);
+    for (ee_size_t i = 0; i < rows; ++i) {
+        tree->levels[i] = tree->items + offset;
+        offset += ctx->size >> i;
     }
-    for (ee_size_t i = 0; i < block->sigma; ++i) {
-        rt[i] = calloc((block->size >> i) - 1, sizeof(**rt));
-        if (NULL == rt[i]) {
-            status = EE_ALLOC_FAILURE;
-            goto rt_i_calloc_error;
+
+    return EE_SUCCESS;
+}
+
+static void
+ee_numeration_ctx_tree_free_s(ee_numeration_ctx_t *ctx, ee_mpz_tree_t *tree)
+{
+    if (NULL != tree->levels) {
+        for (ee_size_t i = 0; i <= ctx->sigma; ++i) {
+            for (ee_size_t j = 0; j < tree->cols[i]; ++j) {
+                mpz_clear(tree->levels[i][j]);
+            }
         }
+
+        free(tree->levels);
     }
 
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        ee_size_t cols = block->size >> i;
-        for (ee_size_t j = 0; j < cols; ++j) {
-            mpz_init(z[i][j].item);
+    tree->levels = NULL;
+    tree->cols = NULL;
+    tree->items = NULL;
+}
+
+/*
+ * Initializes the nodes of levels from..to over the first length leaves that
+ * are not yet, with room for the numbers of a block of that length.  A node
+ * keeps the buffer it has grown to once initialized, so a level is only ever
+ * extended.
+ */
+static void
+ee_mpz_tree_reserve_s(ee_mpz_tree_t *tree, ee_size_t from, ee_size_t to,
+        ee_size_t length)
+{
+    for (ee_size_t i = from; i <= to; ++i) {
+        ee_size_t cols = ee_tree_cols_s(length, i);
+        ee_size_t bits = ee_eval_reserve_bits_s(length, i);
+
+        for (ee_size_t j = tree->cols[i]; j < cols; ++j) {
+            mpz_init2(tree->levels[i][j], bits);
         }
-    }
 
-    for (ee_size_t i = 0; i < block->sigma; ++i) {
-        ee_size_t cols = (block->size >> i) - 1;
-        for (ee_size_t j = 0; j < cols; ++j) {
-            mpz_init(rt[i][j].rho);
-            mpz_init(rt[i][j].theta);
+        if (tree->cols[i] < cols) {
+            tree->cols[i] = cols;
         }
     }
+}
 
-    thetas[0] = 0;
-    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
-        thetas[i + 1] = thetas[i] + statistics->stats[i];
+/*
+ * Level i holds size >> i nodes of ee_limbs_width_s(sigma, i) limbs each, and
+ * all of them follow the level pointers in a single block, leaves first.
+ */
+static ee_int_t
+ee_numeration_ctx_limbs_tree_alloc_s(ee_numeration_ctx_t *ctx,
+        ee_limbs_tree_t *tree)
+{
+    ee_size_t rows = ctx->limbs_level + 1;
+    ee_size_t count = 0;
+    ee_size_t offset = 0;
+
+    for (ee_size_t i = 0; i < rows; ++i) {
+        count += (ctx->size >> i) * ee_limbs_width_s(ctx->sigma, i);
     }
 
-    delta = calloc(zrows, sizeof(*delta));
-    if (NULL == delta) {
-        status = EE_ALLOC_FAILURE;
-        goto delta_calloc_error;
+    tree->levels = calloc(1, rows * sizeof(*(tree->levels))
+            + count * sizeof(*(tree->items)));
+    if (NULL == tree->levels) {
+        tree->items = NULL;
+        return EE_ALLOC_FAILURE;
     }
 
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        ee_size_t cols = block->size >> i;
-        delta[i] = calloc(cols, sizeof(**delta));
-        if (NULL == delta[i]) {
-            status = EE_ALLOC_FAILURE;
-            goto delta_i_calloc_error;
-        }
+    tree->items = (ee_limb_t *)(tree->levels + rows);
+    for (ee_size_t i = 0; i < rows; ++i) {
+        tree->levels[i] = tree->items + offset;
+        offset += (ctx->size >> i) * ee_limbs_width_s(ctx->sigma, i);
     }
 
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        ee_size_t cols = block->size >> i;
-        for (ee_size_t j = 0; j < cols; ++j) {
-            mpz_init(delta[i][j]);
+    return EE_SUCCESS;
+}
+
+static void
+ee_numeration_ctx_limbs_tree_free_s(ee_limbs_tree_t *tree)
+{
+    free(tree->levels);
+    tree->levels = NULL;
+    tree->items = NULL;
+}
+
+/*
+ * Sets the leaves of the length symbols from begin on: rho is the count of
+ * the symbol left from there to the end of the block, and theta the count of
+ * the smaller symbols left after it, both read from the Fenwick tree of
+ * ee_thetas_init_s as the symbols are taken off.
+ */
+static void
+ee_eval_rtd0_s(ee_numeration_ctx_t *ctx, ee_limbs_t *rho, ee_limbs_t *theta,
+        ee_block_t *block, ee_size_t begin, ee_size_t length)
+{
+    for (ee_size_t i = 0; i < length; ++i) {
+        ee_size_t ch = (ee_size_t)block->chars[begin + i];
+        ee_int_t less = 0;
+
+        for (ee_size_t k = ch; k > 0; k &= k - 1) {
+            less += ctx->thetas[k];
         }
+
+        ee_limbs_set_ui_s(&(rho[i]), ctx->counts[ch]);
+        ee_limbs_set_ui_s(&(theta[i]), less);
+        ee_thetas_dec_s(ctx, ch);
     }
+}
 
-    block->length = thetas[EE_ALPHABET_SIZE];
+/*
+ * Builds the rho and theta trees up to ctx->limbs_level one top-level node
+ * at a time, in ctx->rho_limbs and ctx->theta_limbs, whose level i follows
+ * level i - 1 there, and moves each of those nodes into the mpz_t trees.
+ */
+static void
+ee_eval_rtd_limbs_s(ee_numeration_ctx_t *ctx, ee_limbs_tree_t *delta,
+        ee_block_t *block, ee_statistics_t *statistics)
+{
+    ee_size_t top = ctx->limbs_level;
+    ee_size_t leaves = (ee_size_t)1 << top;
+
+    ee_thetas_init_s(ctx, statistics);
+    for (ee_size_t j = 0; j < ee_tree_cols_s(block->length, top); ++j) {
+        ee_size_t begin = j << top;
+        ee_size_t length = block->length - begin;
+        ee_limbs_t *rho = ctx->rho_limbs;
+        ee_limbs_t *theta = ctx->theta_limbs;
+
+        if (length > leaves) {
+            length = leaves;
+        }
 
-    for (ee_size_t i = 0; i < block->size; ++i) {
-        if (i < block->length) {
-            mpz_set_ui(delta[0][i], block->length - i);
-        } else {
-            mpz_set_ui(delta[0][i], 1);
+        ee_eval_rtd0_s(ctx, rho, theta, block, begin, length);
+        for (ee_size_t i = 1; i <= top; ++i) {
+            ee_size_t cols = ee_tree_cols_s(length, i);
+            ee_limbs_t *rho_up = rho + (leaves >> (i - 1));
+            ee_limbs_t *theta_up = theta + (leaves >> (i - 1));
+
+            for (ee_size_t k = 0; k < cols; ++k) {
+                ee_limbs_t delta_r;
+
+                if (((2 * k + 1) << (i - 1)) >= length) {
+                    theta_up[k] = theta[2 * k];
+                    rho_up[k] = rho[2 * k];
+                    continue;
+                }
+
+                ee_limbs_tree_get_s(ctx, &delta_r, delta, i - 1,
+                        (begin >> (i - 1)) + 2 * k + 1);
+                ee_limbs_mul_s(&(theta_up[k]), &(theta[2 * k]), &delta_r);
+                ee_limbs_addmul_s(&(theta_up[k]), &(rho[2 * k]),
+                        &(theta[2 * k + 1]));
+                ee_limbs_mul_s(&(rho_up[k]), &(rho[2 * k]), &(rho[2 * k + 1]));
+            }
+
+            rho = rho_up;
+            theta = theta_up;
         }
+
+        ee_limbs_get_mpz_s(ctx->rho.levels[top][j], rho);
+        ee_limbs_get_mpz_s(ctx->theta.levels[top][j], theta);
     }
+}
+
+/*
+ * Continues the trees from the top level of ee_eval_rtd_limbs_s.  Every
+ * level is kept, so that the root ends up in rho[block->sigma][0] and the
+ * inner nodes stay available to ee_block_restore.
+ */
+static void
+ee_eval_rtd_s(ee_numeration_ctx_t *ctx, mpz_t **rho, mpz_t **theta,
+        mpz_t **delta, ee_block_t *block)
+{
+    for (ee_size_t i = ctx->limbs_level + 1; i <= block->sigma; ++i) {
+        ee_size_t cols = ee_tree_cols_s(block->length, i);
+        mpz_t *rho_dn = rho[i - 1];
+        mpz_t *rho_up = rho[i];
+        for (ee_size_t j = 0; j < cols; ++j) {
+            if (((2 * j + 1) << (i - 1)) >= block->length) {
+                if (NULL != theta) {
+                    mpz_set(theta[i][j], theta[i - 1][2 * j]);
+                }
+
+                mpz_set(rho_up[j], rho_dn[2 * j]);
+                continue;
+            }
 
-    for (ee_size_t i = 1; i < zrows; ++i) {
-        ee_size_t cols = block->size >> i;
-        for (ee_size_t j = 1; j <= cols; ++j) {
-            mpz_mul(delta[i][j - 1], delta[i - 1][2 * j - 2],
-                    delta[i - 1][2 * j - 1]);
+            if (NULL != theta) {
+                mpz_t *theta_dn = theta[i - 1];
+                mpz_mul(ctx->tmp1, theta_dn[2 * j], delta[i - 1][2 * j + 1]);
+                mpz_mul(ctx->tmp2, rho_dn[2 * j], theta_dn[2 * j + 1]);
+                mpz_add(theta[i][j], ctx->tmp1, ctx->tmp2);
+            }
+
+            mpz_mul(rho_up[j], rho_dn[2 * j], rho_dn[2 * j + 1]);
         }
     }
+}
 
-    mpz_mul(z[block->sigma][0].item, rho, number->eta);
-    z[block->sigma][0].init = EE_TRUE;
-    for (ee_size_t i = block->sigma; i > 0; --i) {
-        mpz_fdiv_q(z[i - 1][0].item, z[i][0].item, delta[i - 1][1]);
-        z[i - 1][0].init = EE_TRUE;
-    }
+/*
+ * Returns the number of nodes of the level over the first length leaves.  The
+ * nodes past them only cover padding, with rho and delta of 1 and theta of 0,
+ * so they are never built, and a node whose right child is such a node takes
+ * the numbers of its left child.
+ */
+static ee_size_t
+ee_tree_cols_s(ee_size_t length, ee_size_t level)
+{
+    return (length + ((ee_size_t)1 << level) - 1) >> level;
+}
 
-    for (ee_size_t i = 0; i < block->length; ++i) {
-        if (EE_FALSE == z[0][i].init) {
-            ee_eval_z_s(z, indexes, i, block, rt, delta);
+static ee_delta_cache_item_t *
+ee_delta_cache_get_s(ee_numeration_ctx_t *ctx, ee_size_t length)
+{
+    ee_delta_cache_item_t *item = NULL;
+    mpz_t **delta = NULL;
+    ee_limbs_tree_t *limbs = NULL;
+    ee_limbs_t left, right, product;
+
+    ctx->delta_cache_tick += 1;
+    for (ee_size_t i = 0; i < EE_DELTA_CACHE_SIZE; ++i) {
+        ee_delta_cache_item_t *cur = &(ctx->delta_cache[i]);
+        if (0 != cur->stamp && length == cur->length) {
+            cur->stamp = ctx->delta_cache_tick;
+            return cur;
         }
 
-        ee_block_restore_symbol_s(block, i, rt, delta, thetas, z);
+        if (NULL == item || cur->stamp < item->stamp) {
+            item = cur;
+        }
     }
 
-    for (ee_size_t i = 0; i < block->sigma; ++i) {
-        ee_size_t cols = (block->size >> i) - 1;
-        for (ee_size_t j = 0; j < cols; ++j) {
-            mpz_clear(rt[i][j].rho);
-            mpz_clear(rt[i][j].theta);
-        }
+    ee_mpz_tree_reserve_s(&(item->tree), ctx->limbs_level, ctx->sigma, length);
+    delta = item->tree.levels;
+    limbs = &(item->limbs);
+    for (ee_size_t i = 0; i < length; ++i) {
+        ee_limbs_set_ui_s(&left, length - i);
+        ee_limbs_tree_set_s(ctx, limbs, 0, i, &left);
     }
 
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        ee_size_t cols = block->size >> i;
+    for (ee_size_t i = 1; i <= ctx->limbs_level; ++i) {
+        ee_size_t cols = ee_tree_cols_s(length, i);
         for (ee_size_t j = 0; j < cols; ++j) {
-            mpz_clear(z[i][j].item);
+            ee_limbs_tree_get_s(ctx, &left, limbs, i - 1, 2 * j);
+            if (((2 * j + 1) << (i - 1)) >= length) {
+                ee_limbs_tree_set_s(ctx, limbs, i, j, &left);
+                continue;
+            }
+
+            ee_limbs_tree_get_s(ctx, &right, limbs, i - 1, 2 * j + 1);
+            ee_limbs_mul_s(&product, &left, &right);
+            ee_limbs_tree_set_s(ctx, limbs, i, j, &product);
         }
     }
 
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        ee_size_t cols = block->size >> i;
+    for (ee_size_t j = 0; j < ee_tree_cols_s(length, ctx->limbs_level); ++j) {
+        ee_limbs_tree_get_s(ctx, &left, limbs, ctx->limbs_level, j);
+        ee_limbs_get_mpz_s(delta[ctx->limbs_level][j], &left);
+    }
+
+    for (ee_size_t i = ctx->limbs_level + 1; i <= ctx->sigma; ++i) {
+        ee_size_t cols = ee_tree_cols_s(length, i);
         for (ee_size_t j = 0; j < cols; ++j) {
-            mpz_clear(delta[i][j]);
+            if (((2 * j + 1) << (i - 1)) >= length) {
+                mpz_set(delta[i][j], delta[i - 1][2 * j]);
+            } else {
+                mpz_mul(delta[i][j], delta[i - 1][2 * j],
+                        delta[i - 1][2 * j + 1]);
+            }
         }
     }
 
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        free(delta[i]);
+    item->length = length;
+    item->stamp = ctx->delta_cache_tick;
+    item->tree_complete = EE_FALSE;
+
+    return item;
+}
+
+/*
+ * Only the levels of the mpz_t tree from ctx->limbs_level up are built with
+ * the item; the ones below are only needed when a z too long for the limbs is
+ * restored, and are built from the limbs then, next to the rho levels that
+ * the restoration needs there.
+ */
+static void
+ee_delta_cache_complete_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *item)
+{
+    if (EE_TRUE == item->tree_complete) {
+        return;
     }
-delta_i_calloc_error:
-    free(delta);
-delta_calloc_error:
-    for (ee_size_t i = 0; i < block->sigma; ++i) {
-        free(rt[i]);
+
+    if (0 < ctx->limbs_level) {
+        ee_mpz_tree_reserve_s(&(item->tree), 0, ctx->limbs_level - 1,
+                item->length);
+        ee_mpz_tree_reserve_s(&(ctx->rho), 0, ctx->limbs_level - 1,
+                item->length);
     }
-rt_i_calloc_error:
-    free(rt);
-rt_calloc_error:
-    for (ee_size_t i = 0; i < zrows; ++i) {
-        free(z[i]);
+
+    for (ee_size_t i = 0; i < ctx->limbs_level; ++i) {
+        for (ee_size_t j = 0; j < ee_tree_cols_s(item->length, i); ++j) {
+            ee_limbs_t limbs;
+
+            ee_limbs_tree_get_s(ctx, &limbs, &(item->limbs), i, j);
+            ee_limbs_get_mpz_s(item->tree.levels[i][j], &limbs);
+        }
     }
-z_i_calloc_error:
-    free(z);
-z_calloc_error:
-    free(indexes);
-indexes_calloc_error:
-    free(thetas);
-thetas_calloc_error:
-    return status;
+
+    item->tree_complete = EE_TRUE;
 }
 
+/*
+ * rho is the product of the counts remaining at every position, which is the
+ * product of the factorials of the symbol counts.  The factorials are put in
+ * the leaves of the rho tree, which is free outside ee_number_eval and
+ * ee_block_restore, and multiplied pairwise up its levels; every node keeps
+ * the buffer it has grown to, so a warm context does not allocate here.
+ */
 static void
-ee_eval_rtd0_s(mpz_t *rho, mpz_t *theta, mpz_t *delta, ee_block_t *block,
+ee_eval_rho_stats_s(ee_numeration_ctx_t *ctx, mpz_t rho,
         ee_statistics_t *statistics)
 {
-    ee_int_t iter_stats[EE_ALPHABET_SIZE];
-    ee_int_t tmp_theta;
+    mpz_t **levels = ctx->rho.levels;
+    ee_size_t leaves = 0;
+    ee_size_t count = 0;
+    ee_size_t level = 0;
 
-    if (NULL != rho) {
-        memcpy(iter_stats, statistics->stats, sizeof(iter_stats));
-        mpz_set_ui(rho[0], iter_stats[(ee_size_t)block->chars[0]]);
+    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
+        if (statistics->stats[i] >= 2) {
+            leaves += 1;
+        }
     }
 
-    if (NULL != theta) {
-        tmp_theta = 0;
-        for (ee_size_t i = 1; i < block->length; ++i) {
-            if (block->chars[i] < block->chars[0]) {
-                tmp_theta += 1;
-            }
+    ee_mpz_tree_reserve_s(&(ctx->rho), 0, 0, leaves);
+    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
+        ee_size_t n = statistics->stats[i];
+        if (n < 2) {
+            continue;
         }
 
-        mpz_set_ui(theta[0], tmp_theta);
+        if (n < ctx->factorials_count) {
+            mpz_set(levels[0][count], ctx->factorials[n]);
+        } else {
+            mpz_fac_ui(levels[0][count], n);
+        }
+
+        count += 1;
     }
 
-    if (NULL != delta) {
-        mpz_set_ui(delta[0], block->length);
+    if (0 == count) {
+        mpz_set_ui(rho, 1);
+        return;
     }
 
-    for (ee_size_t i = 1; i < block->size; ++i) {
-        if (i < block->length) {
-            if (NULL != rho) {
-                iter_stats[(ee_size_t)block->chars[i - 1]] -= 1;
-                mpz_set_ui(rho[i], iter_stats[(ee_size_t)block->chars[i]]);
-            }
+    while (count > 1) {
+        ee_mpz_tree_reserve_s(&(ctx->rho), level + 1, level + 1, leaves);
+        for (ee_size_t j = 0; 2 * j + 1 < count; ++j) {
+            mpz_mul(levels[level + 1][j], levels[level][2 * j],
+                    levels[level][2 * j + 1]);
+        }
 
-            if (NULL != theta) {
-                tmp_theta = 0;
-                for (ee_size_t j = i + 1; j < block->length; ++j) {
-                    if (block->chars[j] < block->chars[i]) {
-                        tmp_theta += 1;
-                    }
-                }
+        if ((count & 0x01) == 1) {
+            mpz_set(levels[level + 1][count / 2], levels[level][count - 1]);
+        }
 
-                mpz_set_ui(theta[i], tmp_theta);
-            }
+        count = (count + 1) / 2;
+        level += 1;
+    }
 
-            if (NULL != delta) {
-                mpz_set_ui(delta[i], block->length - i);
-            }
-        } else {
-            if (NULL != rho) {
-                mpz_set_ui(rho[i], 1);
-            }
+    mpz_set(rho, levels[level][0]);
+}
 
-            if (NULL != theta) {
-                mpz_set_ui(theta[i], 0);
+/*
+ * Returns the position of the count-th set bit of delta, counting from the
+ * top, and skips whole limbs by their population count.
+ */
+static ee_size_t
+ee_delta_set_bit_s(mpz_t delta, ee_size_t count)
+{
+    for (ee_size_t i = mpz_size(delta); i > 0; --i) {
+        mp_limb_t limb = mpz_getlimbn(delta, i - 1);
+        ee_size_t limb_count = ee_limb_popcount_s(limb);
+
+        if (count <= limb_count) {
+            ee_size_t bit = GMP_NUMB_BITS;
+            while (count > 0) {
+                bit -= 1;
+                if (0 != ((limb >> bit) & 0x01)) {
+                    count -= 1;
+                }
             }
 
-            if (NULL != delta) {
-                mpz_set_ui(delta[i], 1);
-            }
+            return (i - 1) * GMP_NUMB_BITS + bit;
+        }
+
+        count -= limb_count;
+    }
+
+    return 0;
+}
+
+static ee_size_t
+ee_limb_popcount_s(mp_limb_t limb)
+{
+    ee_size_t count = 0;
+
+    for (; 0 != limb; limb &= limb - 1) {
+        count += 1;
+    }
+
+    return count;
+}
+
+/*
+ * Restores the symbols under the node (level, index) from its z, which is
+ * expected in z[level].  With L and R its children, z = thetaL * deltaR
+ * + rhoL * thetaR + e, where the excess e is below rho, so one division by
+ * deltaR gives the z of L.  Once L is restored with its own excess eL, the
+ * remainder plus eL * deltaR is rhoL * thetaR + e, and its division by rhoL
+ * gives the z of R.  If need_rho is set, the node's rho and e are left for
+ * its parent.
+ *
+ * ops is constant in each of the two node functions that call the walk, so
+ * that each of them gets its own copy with the arithmetic called directly.
+ */
+static inline void
+ee_block_restore_walk_s(ee_numeration_ctx_t *ctx, const ee_restore_ops_t *ops,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t level,
+        ee_size_t index, ee_bool_t need_rho)
+{
+    ee_size_t left = 2 * index;
+    ee_size_t right = 2 * index + 1;
+
+    if (0 == level) {
+        ops->leaf(ctx, block, index);
+        return;
+    }
+
+    if ((right << (level - 1)) >= block->length) {
+        ops->pad(ctx, delta, level, index);
+        ops->node(ctx, delta, block, level - 1, left, need_rho);
+        if (EE_TRUE == need_rho) {
+            ops->pad_up(ctx, delta, level, index);
         }
+
+        return;
+    }
+
+    ops->split(ctx, delta, level, index);
+    ops->node(ctx, delta, block, level - 1, left, EE_TRUE);
+    ops->carry(ctx, delta, level, index);
+    ops->node(ctx, delta, block, level - 1, right, need_rho);
+    if (EE_TRUE == need_rho) {
+        ops->join(ctx, delta, level, index);
+    }
+}
+
+/*
+ * Restores the node on the mpz_t numbers of the context, and from
+ * ctx->limbs_level down on the ee_limbs_t ones, unless z is too long for
+ * them, which only comes from a wrong key or damaged input.
+ */
+static void
+ee_block_restore_node_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t level,
+        ee_size_t index, ee_bool_t need_rho)
+{
+    if (level == ctx->limbs_level && EE_TRUE == ee_block_restore_limbs_s(ctx,
+            delta, block, index, need_rho)) {
+        return;
     }
+
+    ee_block_restore_walk_s(ctx, &ee_restore_mpz_ops_s, delta, block, level,
+            index, need_rho);
 }
 
 static void
-ee_eval_rtd_s(mpz_t *rho, mpz_t *theta, mpz_t *delta, ee_block_t *block)
+ee_block_restore_limbs_node_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t level,
+        ee_size_t index, ee_bool_t need_rho)
 {
-    mpz_t tmp1 = EE_MPZ_NULL, tmp2 = EE_MPZ_NULL;
+    ee_block_restore_walk_s(ctx, &ee_restore_limbs_ops_s, delta, block, level,
+            index, need_rho);
+}
 
-    if (NULL != theta && NULL != delta) {
-        mpz_init(tmp1);
-        mpz_init(tmp2);
+/*
+ * Restores the node (ctx->limbs_level, index) in ee_limbs_t numbers and
+ * moves its rho and excess back into the mpz_t ones, or, if its z does not
+ * fit them, builds the mpz_t levels below it and returns EE_FALSE.
+ */
+static ee_bool_t
+ee_block_restore_limbs_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_block_t *block, ee_size_t index,
+        ee_bool_t need_rho)
+{
+    ee_size_t level = ctx->limbs_level;
+
+    if (EE_LIMBS_MAX * EE_LIMB_BITS < mpz_sizeinbase(ctx->z[level], 2)) {
+        ee_delta_cache_complete_s(ctx, delta);
+        return EE_FALSE;
     }
 
-    for (ee_size_t i = 1; i <= block->sigma; ++i) {
-        ee_size_t jmax = 1 << (block->sigma - i);
-        for (ee_size_t j = 1; j <= jmax; ++j) {
-            if (NULL != theta && NULL != rho && NULL != delta) {
-                mpz_mul(tmp1, theta[2 * j - 2], delta[2 * j - 1]);
-                mpz_mul(tmp2, rho[2 * j - 2], theta[2 * j - 1]);
-                mpz_add(theta[j - 1], tmp1, tmp2);
-            }
+    ee_limbs_set_mpz_s(&(ctx->z_limbs[level]), ctx->z[level]);
+    ee_block_restore_limbs_node_s(ctx, delta, block, level, index, need_rho);
+    if (EE_TRUE == need_rho) {
+        ee_limbs_get_mpz_s(ctx->rho.levels[level][index],
+                ee_block_restore_rho_limbs_s(ctx, level, index));
+        ee_limbs_get_mpz_s(ctx->excess[level], &(ctx->excess_limbs[level]));
+    }
+
+    return EE_TRUE;
+}
+
+/*
+ * z[level - 1] is reserved for a number of this level too; copying rather
+ * than swapping keeps every z at the buffer it has grown to.
+ */
+static void
+ee_block_restore_pad_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    mpz_set(ctx->z[level - 1], ctx->z[level]);
+}
+
+static void
+ee_block_restore_pad_up_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    mpz_t **rho = ctx->rho.levels;
+
+    mpz_set(rho[level][index], rho[level - 1][2 * index]);
+    mpz_set(ctx->excess[level], ctx->excess[level - 1]);
+}
+
+static void
+ee_block_restore_split_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    mpz_tdiv_qr(ctx->z[level - 1], ctx->rem[level - 1], ctx->z[level],
+            delta->tree.levels[level - 1][2 * index + 1]);
+}
+
+static void
+ee_block_restore_carry_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    mpz_t *rem = ctx->rem;
+
+    mpz_addmul(rem[level - 1], ctx->excess[level - 1],
+            delta->tree.levels[level - 1][2 * index + 1]);
+    mpz_tdiv_qr(ctx->z[level - 1], rem[level - 1], rem[level - 1],
+            ctx->rho.levels[level - 1][2 * index]);
+}
+
+static void
+ee_block_restore_join_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    mpz_t **rho = ctx->rho.levels;
+    mpz_t *excess = ctx->excess;
+
+    mpz_mul(excess[level], excess[level - 1], rho[level - 1][2 * index]);
+    mpz_add(excess[level], excess[level], ctx->rem[level - 1]);
+    mpz_mul(rho[level][index], rho[level - 1][2 * index],
+            rho[level - 1][2 * index + 1]);
+}
+
+static void
+ee_block_restore_symbol_s(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_size_t sym_idx)
+{
+    mpz_t *z = ctx->z;
+    ee_int_t less = -1;
+    ee_int_t count;
+
+    if (0 != mpz_fits_ulong_p(z[0])
+            && mpz_get_ui(z[0]) < block->length - sym_idx) {
+        less = mpz_get_ui(z[0]);
+    }
+
+    count = ee_block_restore_char_s(ctx, block, sym_idx, &less);
+    mpz_set_ui(ctx->rho.levels[0][sym_idx], count);
+    mpz_set_ui(ctx->excess[0], less);
+}
+
+static void
+ee_block_restore_limbs_pad_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    ctx->z_limbs[level - 1] = ctx->z_limbs[level];
+}
+
+static void
+ee_block_restore_limbs_pad_up_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    *ee_block_restore_rho_limbs_s(ctx, level, index)
+            = *ee_block_restore_rho_limbs_s(ctx, level - 1, 2 * index);
+    ctx->excess_limbs[level] = ctx->excess_limbs[level - 1];
+}
+
+/*
+ * The delta of the right child is loaded once into ctx->delta_limbs, where
+ * the carry finds it after the left child.
+ */
+static void
+ee_block_restore_limbs_split_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    ee_limbs_t *delta_r = &(ctx->delta_limbs[level - 1]);
+
+    ee_limbs_tree_get_s(ctx, delta_r, &(delta->limbs), level - 1,
+            2 * index + 1);
+    ee_limbs_tdiv_qr_s(&(ctx->z_limbs[level - 1]),
+            &(ctx->rem_limbs[level - 1]), &(ctx->z_limbs[level]), delta_r);
+}
+
+static void
+ee_block_restore_limbs_carry_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    ee_limbs_t *rem = &(ctx->rem_limbs[level - 1]);
+
+    ee_limbs_addmul_s(rem, &(ctx->excess_limbs[level - 1]),
+            &(ctx->delta_limbs[level - 1]));
+    ee_limbs_tdiv_qr_s(&(ctx->z_limbs[level - 1]), rem, rem,
+            ee_block_restore_rho_limbs_s(ctx, level - 1, 2 * index));
+}
+
+static void
+ee_block_restore_limbs_join_s(ee_numeration_ctx_t *ctx,
+        ee_delta_cache_item_t *delta, ee_size_t level, ee_size_t index)
+{
+    ee_limbs_t *rho_l = ee_block_restore_rho_limbs_s(ctx, level - 1,
+            2 * index);
+    ee_limbs_t *rho_r = ee_block_restore_rho_limbs_s(ctx, level - 1,
+            2 * index + 1);
+    ee_limbs_t *excess = ctx->excess_limbs;
+
+    ee_limbs_mul_s(&(excess[level]), &(excess[level - 1]), rho_l);
+    ee_limbs_add_s(&(excess[level]), &(ctx->rem_limbs[level - 1]));
+    ee_limbs_mul_s(ee_block_restore_rho_limbs_s(ctx, level, index), rho_l,
+            rho_r);
+}
+
+static void
+ee_block_restore_limbs_symbol_s(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_size_t sym_idx)
+{
+    ee_limbs_t *z = &(ctx->z_limbs[0]);
+    ee_int_t less = -1;
+    ee_int_t count;
+
+    if (0 == z->size) {
+        less = 0;
+    } else if (1 == z->size && z->limbs[0] < block->length - sym_idx) {
+        less = (ee_int_t)z->limbs[0];
+    }
+
+    count = ee_block_restore_char_s(ctx, block, sym_idx, &less);
+    ee_limbs_set_ui_s(ee_block_restore_rho_limbs_s(ctx, 0, sym_idx), count);
+    ee_limbs_set_ui_s(&(ctx->excess_limbs[0]), less);
+}
+
+/*
+ * From ctx->limbs_level down, the rho of a node is only read by its parent,
+ * and the one of a left child is read after its sibling is restored, so each
+ * level keeps the rho of a left and of a right child in ctx->rho_limbs.
+ */
+static ee_limbs_t *
+ee_block_restore_rho_limbs_s(ee_numeration_ctx_t *ctx, ee_size_t level,
+        ee_size_t index)
+{
+    return &(ctx->rho_limbs[2 * level + (index & 0x01)]);
+}
+
+/*
+ * Restores the symbol at sym_idx from its z, given in less, and returns the
+ * count of the symbol before it, that is, the leaf's rho; the excess of z is
+ * left in less.  A negative less stands for a z that is out of range, which
+ * only comes from a wrong key or damaged input; the symbol is left as is and
+ * rho of 1 keeps the divisions above valid.
+ */
+static ee_int_t
+ee_block_restore_char_s(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_size_t sym_idx, ee_int_t *less)
+{
+    ee_int_t count;
+    ee_size_t ch;
+
+    if (0 > *less) {
+        *less = 0;
+        return 1;
+    }
+
+    ch = ee_thetas_find_s(ctx->thetas, less);
+    block->chars[sym_idx] = (ee_char_t)ch;
+    count = ctx->counts[ch];
+    ee_thetas_dec_s(ctx, ch);
+
+    return count;
+}
+
+/*
+ * Sets ctx->counts to the symbol counts and ctx->thetas to a Fenwick tree
+ * over them, so that the cumulative count below a symbol is found and
+ * updated in O(log EE_ALPHABET_SIZE), and returns the block length.
+ */
+static ee_size_t
+ee_thetas_init_s(ee_numeration_ctx_t *ctx, ee_statistics_t *statistics)
+{
+    ee_int_t *thetas = ctx->thetas;
+    ee_size_t length = 0;
+
+    memcpy(ctx->counts, statistics->stats, sizeof(statistics->stats));
+    thetas[0] = 0;
+    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
+        thetas[i + 1] = ctx->counts[i];
+        length += ctx->counts[i];
+    }
+
+    for (ee_size_t k = 1; k <= EE_ALPHABET_SIZE; ++k) {
+        ee_size_t parent = k + (k & (~k + 1));
+        if (parent <= EE_ALPHABET_SIZE) {
+            thetas[parent] += thetas[k];
+        }
+    }
+
+    return length;
+}
+
+static ee_size_t
+ee_thetas_find_s(ee_int_t *thetas, ee_int_t *less)
+{
+    ee_size_t ch = 0;
+
+    for (ee_size_t step = EE_ALPHABET_SIZE; step > 0; step /= 2) {
+        if (ch + step <= EE_ALPHABET_SIZE && thetas[ch + step] <= *less) {
+            ch += step;
+            *less -= thetas[ch];
+        }
+    }
+
+    return ch;
+}
+
+static void
+ee_thetas_dec_s(ee_numeration_ctx_t *ctx, ee_size_t ch)
+{
+    ctx->counts[ch] -= 1;
+    for (ee_size_t k = ch + 1; k <= EE_ALPHABET_SIZE; k += k & (~k + 1)) {
+        ctx->thetas[k] -= 1;
+    }
+}
 
-            if (NULL != rho) {
-                mpz_mul(rho[j - 1], rho[2 * j - 2], rho[2 * j - 1]);
+/*
+ * Folds the same (rho, theta, delta) products as ee_eval_rtd_s, but from
+ * the last symbol to the first instead of over a tree.
+ */
+static void
+ee_eval_rtd_word_s(ee_block_t *block, ee_word_t *rho, ee_word_t *theta,
+        ee_word_t *delta)
+{
+    ee_int_t tree[EE_ALPHABET_SIZE + 1];
+    ee_int_t seen[EE_ALPHABET_SIZE];
+    ee_word_t rho_w = 1, theta_w = 0, delta_w = 1;
+
+    ee_memset(tree, 0, sizeof(tree));
+    ee_memset(seen, 0, sizeof(seen));
+    for (ee_size_t i = block->length; i > 0; --i) {
+        ee_size_t ch = (ee_size_t)block->chars[i - 1];
+        ee_int_t less = 0;
+
+        if (NULL != theta) {
+            for (ee_size_t k = ch; k > 0; k &= k - 1) {
+                less += tree[k];
             }
 
-            if (NULL != delta) {
-                mpz_mul(delta[j - 1], delta[2 * j - 2], delta[2 * j - 1]);
+            for (ee_size_t k = ch + 1; k <= EE_ALPHABET_SIZE;
+                    k += k & (~k + 1)) {
+                tree[k] += 1;
             }
         }
+
+        seen[ch] += 1;
+        theta_w = less * delta_w + seen[ch] * theta_w;
+        rho_w *= seen[ch];
+        delta_w *= block->length - (i - 1);
     }
 
-    if (NULL != theta && NULL != delta) {
-        mpz_clear(tmp2);
-        mpz_clear(tmp1);
+    *rho = rho_w;
+    if (NULL != theta) {
+        *theta = theta_w;
+    }
+
+    if (NULL != delta) {
+        *delta = delta_w;
     }
 }
 
 static void
-ee_eval_z_s(ee_z_item_t **z, ee_int_t *indexes, ee_size_t sym_idx,
-        ee_block_t *block, ee_rt_item_t **rt, mpz_t **delta)
+ee_block_restore_word_s(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_word_t z)
 {
-    ee_size_t cur_z;
-    mpz_t tmp1 = EE_MPZ_NULL, tmp2 = EE_MPZ_NULL;
+    ee_word_t suffix = 1;
+
+    for (ee_size_t i = 2; i < block->length; ++i) {
+        suffix *= i;
+    }
 
-    mpz_init(tmp1);
-    mpz_init(tmp2);
+    for (ee_size_t i = 0; i < block->length; ++i) {
+        ee_word_t theta_w = z / suffix;
+        ee_int_t less;
+        ee_size_t ch;
 
-    indexes[0] = sym_idx;
-    for (cur_z = 1; cur_z < block->sigma + 1; ++cur_z) {
-        indexes[cur_z] = indexes[cur_z - 1] / 2;
-        if (EE_TRUE == z[cur_z][indexes[cur_z]].init) {
+        if (theta_w >= block->length - i) {
             break;
         }
+
+        less = (ee_int_t)theta_w;
+        ch = ee_thetas_find_s(ctx->thetas, &less);
+        block->chars[i] = (ee_char_t)ch;
+        theta_w -= less;
+        z = (z - theta_w * suffix) / ctx->counts[ch];
+        ee_thetas_dec_s(ctx, ch);
+        if (i + 1 < block->length) {
+            suffix /= block->length - 1 - i;
+        }
     }
+}
 
-    do {
-        cur_z -= 1;
-        if ((indexes[cur_z] & 0x01) == 1) {
-            mpz_mul(tmp1, rt[cur_z][indexes[cur_z] - 1].theta,
-                    delta[cur_z][indexes[cur_z]]);
-            mpz_sub(tmp2, z[cur_z + 1][indexes[cur_z + 1]].item, tmp1);
-            mpz_fdiv_q(z[cur_z][indexes[cur_z]].item, tmp2,
-                       rt[cur_z][indexes[cur_z] - 1].rho);
-        } else {
-            mpz_fdiv_q(z[cur_z][indexes[cur_z]].item,
-                       z[cur_z + 1][indexes[cur_z + 1]].item,
-                       delta[cur_z][indexes[cur_z] + 1]);
+static ee_bool_t
+ee_word_fits_s(mpz_t mpz)
+{
+    return (mpz_sizeinbase(mpz, 2) <= sizeof(ee_word_t) * EE_BITS_IN_BYTE)
+            ? EE_TRUE : EE_FALSE;
+}
+
+static ee_word_t
+ee_word_get_s(mpz_t mpz)
+{
+    ee_word_t word = 0;
+
+    mpz_export(&word, NULL, -1, sizeof(word), 0, 0, mpz);
+
+    return word;
+}
+
+static void
+ee_word_set_s(mpz_t mpz, ee_word_t word)
+{
+    mpz_import(mpz, 1, -1, sizeof(word), 0, 0, &word);
+}
+
+static void
+ee_limbs_set_ui_s(ee_limbs_t *r, ee_limb_t value)
+{
+    r->limbs[0] = value;
+    r->size = (0 == value) ? 0 : 1;
+}
+
+/*
+ * Sets r to r + a.
+ */
+static void
+ee_limbs_add_s(ee_limbs_t *r, const ee_limbs_t *a)
+{
+    ee_word_t carry = 0;
+    ee_size_t i;
+
+    for (i = r->size; i < a->size; ++i) {
+        r->limbs[i] = 0;
+    }
+
+    if (r->size < a->size) {
+        r->size = a->size;
+    }
+
+    for (i = 0; i < r->size && (i < a->size || 0 != carry); ++i) {
+        carry += (ee_word_t)r->limbs[i] + ((i < a->size) ? a->limbs[i] : 0);
+        r->limbs[i] = (ee_limb_t)carry;
+        carry >>= EE_LIMB_BITS;
+    }
+
+    if (0 != carry) {
+        r->limbs[r->size] = (ee_limb_t)carry;
+        r->size += 1;
+    }
+}
+
+/*
+ * Sets r to a * b by schoolbook multiplication; r must not be a or b.
+ */
+static void
+ee_limbs_mul_s(ee_limbs_t *r, const ee_limbs_t *a, const ee_limbs_t *b)
+{
+    const ee_limb_t *al = a->limbs;
+    const ee_limb_t *bl = b->limbs;
+    ee_limb_t *rl = r->limbs;
+    ee_size_t an = a->size;
+    ee_size_t bn = b->size;
+    ee_word_t carry = 0;
+
+    if (0 == an || 0 == bn) {
+        r->size = 0;
+        return;
+    }
+
+    for (ee_size_t j = 0; j < bn; ++j) {
+        carry += (ee_word_t)al[0] * bl[j];
+        rl[j] = (ee_limb_t)carry;
+        carry >>= EE_LIMB_BITS;
+    }
+
+    rl[bn] = (ee_limb_t)carry;
+    for (ee_size_t i = 1; i < an; ++i) {
+        ee_limb_t ai = al[i];
+
+        carry = 0;
+        for (ee_size_t j = 0; j < bn; ++j) {
+            carry += (ee_word_t)ai * bl[j] + rl[i + j];
+            rl[i + j] = (ee_limb_t)carry;
+            carry >>= EE_LIMB_BITS;
         }
 
-        z[cur_z][indexes[cur_z]].init = EE_TRUE;
-    } while (cur_z != 0);
+        rl[i + bn] = (ee_limb_t)carry;
+    }
 
-    mpz_clear(tmp2);
-    mpz_clear(tmp1);
+    r->size = (0 == rl[an + bn - 1]) ? an + bn - 1 : an + bn;
 }
 
+/*
+ * Sets r to r + a * b; r must not be a or b.
+ */
 static void
-ee_block_restore_symbol_s(ee_block_t *block, ee_size_t sym_idx,
-        ee_rt_item_t **rtd, mpz_t **delta, ee_int_t *thetas, ee_z_item_t **z)
+ee_limbs_addmul_s(ee_limbs_t *r, const ee_limbs_t *a, const ee_limbs_t *b)
 {
-    mpz_t tmp1 = EE_MPZ_NULL, tmp2 = EE_MPZ_NULL;
+    const ee_limb_t *al = a->limbs;
+    const ee_limb_t *bl = b->limbs;
+    ee_limb_t *rl = r->limbs;
+    ee_size_t an = a->size;
+    ee_size_t bn = b->size;
+    ee_size_t rn = r->size;
+
+    if (0 == an || 0 == bn) {
+        return;
+    }
 
-    mpz_init(tmp1);
-    mpz_init(tmp2);
+    for (; rn < an + bn; ++rn) {
+        rl[rn] = 0;
+    }
 
-    ee_size_t ch;
-    for (ch = 0; ch < EE_ALPHABET_SIZE; ++ch) {
-        if (       mpz_cmp_ui(z[0][sym_idx].item, thetas[ch]) >= 0
-                && mpz_cmp_ui(z[0][sym_idx].item, thetas[ch + 1]) < 0) {
-            block->chars[sym_idx] = (ee_char_t)ch;
-            if (sym_idx == block->length - 1) {
+    for (ee_size_t i = 0; i < an; ++i) {
+        ee_limb_t ai = al[i];
+        ee_word_t carry = 0;
+        ee_size_t k;
+
+        for (ee_size_t j = 0; j < bn; ++j) {
+            carry += (ee_word_t)ai * bl[j] + rl[i + j];
+            rl[i + j] = (ee_limb_t)carry;
+            carry >>= EE_LIMB_BITS;
+        }
+
+        for (k = i + bn; 0 != carry && k < rn; ++k) {
+            carry += rl[k];
+            rl[k] = (ee_limb_t)carry;
+            carry >>= EE_LIMB_BITS;
+        }
+
+        if (0 != carry) {
+            rl[rn] = (ee_limb_t)carry;
+            rn += 1;
+        }
+    }
+
+    r->size = rn;
+    ee_limbs_normalize_s(r);
+}
+
+/*
+ * Sets q and r to the quotient and the remainder of n by a nonzero d, with
+ * Knuth's algorithm D: d is shifted until its top bit is set, so that every
+ * quotient limb estimated from the top two limbs of the remainder and the top
+ * limb of d is at most two too large.  r may be n, q must be neither.
+ */
+static void
+ee_limbs_tdiv_qr_s(ee_limbs_t *q, ee_limbs_t *r, const ee_limbs_t *n,
+        const ee_limbs_t *d)
+{
+    ee_limb_t un[EE_LIMBS_MAX + 1];
+    ee_limb_t vn[EE_LIMBS_MAX];
+    ee_size_t nn = n->size;
+    ee_size_t dn = d->size;
+    ee_size_t shift = 0;
+
+    if (nn < dn) {
+        q->size = 0;
+        *r = *n;
+        return;
+    }
+
+    if (1 == dn) {
+        ee_word_t rem = 0;
+        for (ee_size_t i = nn; i > 0; --i) {
+            rem = (rem << EE_LIMB_BITS) | n->limbs[i - 1];
+            q->limbs[i - 1] = (ee_limb_t)(rem / d->limbs[0]);
+            rem %= d->limbs[0];
+        }
+
+        q->size = nn;
+        ee_limbs_normalize_s(q);
+        ee_limbs_set_ui_s(r, (ee_limb_t)rem);
+        return;
+    }
+
+    while (0 == ((d->limbs[dn - 1] << shift) >> (EE_LIMB_BITS - 1))) {
+        shift += 1;
+    }
+
+    for (ee_size_t i = dn - 1; i > 0; --i) {
+        vn[i] = (d->limbs[i] << shift) | ((0 == shift)
+                ? 0 : d->limbs[i - 1] >> (EE_LIMB_BITS - shift));
+    }
+
+    vn[0] = d->limbs[0] << shift;
+    un[nn] = (0 == shift) ? 0 : n->limbs[nn - 1] >> (EE_LIMB_BITS - shift);
+    for (ee_size_t i = nn - 1; i > 0; --i) {
+        un[i] = (n->limbs[i] << shift) | ((0 == shift)
+                ? 0 : n->limbs[i - 1] >> (EE_LIMB_BITS - shift));
+    }
+
+    un[0] = n->limbs[0] << shift;
+
+    for (ee_size_t j = nn - dn + 1; j > 0; --j) {
+        ee_size_t k = j - 1;
+        ee_word_t top = ((ee_word_t)un[k + dn] << EE_LIMB_BITS)
+                | un[k + dn - 1];
+        ee_word_t qhat = top / vn[dn - 1];
+        ee_word_t rhat = top % vn[dn - 1];
+        ee_word_t carry = 0;
+        ee_word_t borrow = 0;
+
+        while (0 != (qhat >> EE_LIMB_BITS) || qhat * vn[dn - 2]
+                > ((rhat << EE_LIMB_BITS) | un[k + dn - 2])) {
+            qhat -= 1;
+            rhat += vn[dn - 1];
+            if (0 != (rhat >> EE_LIMB_BITS)) {
                 break;
             }
+        }
+
+        for (ee_size_t i = 0; i < dn; ++i) {
+            ee_word_t diff;
+
+            carry += qhat * vn[i];
+            diff = (ee_word_t)un[k + i] - (ee_limb_t)carry - borrow;
+            un[k + i] = (ee_limb_t)diff;
+            borrow = (0 == (diff >> EE_LIMB_BITS)) ? 0 : 1;
+            carry >>= EE_LIMB_BITS;
+        }
 
-            mpz_set_ui(rtd[0][sym_idx].rho, thetas[ch + 1] - thetas[ch]);
-            mpz_set_ui(rtd[0][sym_idx].theta, thetas[ch]);
-            for (   ee_size_t k = sym_idx, l = 0;
-                    ((k & 0x01) == 1) && (l < block->sigma - 1);
-                    k /= 2, ++l) {
-                mpz_mul(rtd[l + 1][k / 2].rho, rtd[l][k - 1].rho, rtd[l][k].rho);
-                mpz_mul(tmp1, rtd[l][k - 1].theta, delta[l][k]);
-                mpz_mul(tmp2, rtd[l][k - 1].rho, rtd[l][k].theta);
-                mpz_add(rtd[l + 1][k / 2].theta, tmp1, tmp2);
+        carry = (ee_word_t)un[k + dn] - carry - borrow;
+        un[k + dn] = (ee_limb_t)carry;
+        if (0 != (carry >> EE_LIMB_BITS)) {
+            ee_word_t sum = 0;
+
+            qhat -= 1;
+            for (ee_size_t i = 0; i < dn; ++i) {
+                sum += (ee_word_t)un[k + i] + vn[i];
+                un[k + i] = (ee_limb_t)sum;
+                sum >>= EE_LIMB_BITS;
             }
 
-            break;
+            un[k + dn] += (ee_limb_t)sum;
         }
+
+        q->limbs[k] = (ee_limb_t)qhat;
     }
 
-    mpz_clear(tmp2);
-    mpz_clear(tmp1);
+    q->size = nn - dn + 1;
+    ee_limbs_normalize_s(q);
+
+    for (ee_size_t i = 0; i < dn; ++i) {
+        r->limbs[i] = (un[i] >> shift) | ((0 == shift)
+                ? 0 : un[i + 1] << (EE_LIMB_BITS - shift));
+    }
+
+    r->size = dn;
+    ee_limbs_normalize_s(r);
+}
+
+static void
+ee_limbs_normalize_s(ee_limbs_t *r)
+{
+    while (0 < r->size && 0 == r->limbs[r->size - 1]) {
+        r->size -= 1;
+    }
+}
+
+static void
+ee_limbs_get_mpz_s(mpz_t mpz, const ee_limbs_t *a)
+{
+    mpz_import(mpz, a->size, -1, sizeof(ee_limb_t), 0, 0, a->limbs);
+}
+
+/*
+ * mpz must fit in EE_LIMBS_MAX limbs.
+ */
+static void
+ee_limbs_set_mpz_s(ee_limbs_t *r, mpz_t mpz)
+{
+    size_t count = 0;
+
+    mpz_export(r->limbs, &count, -1, sizeof(ee_limb_t), 0, 0, mpz);
+    r->size = count;
+}
+
+/*
+ * Every number of a level i node is below 2^(2^i * (sigma + 1)).
+ */
+static ee_size_t
+ee_limbs_width_s(ee_size_t sigma, ee_size_t level)
+{
+    return (((ee_size_t)1 << level) * (sigma + 1) + EE_LIMB_BITS - 1)
+            / EE_LIMB_BITS;
+}
+
+static void
+ee_limbs_tree_get_s(ee_numeration_ctx_t *ctx, ee_limbs_t *r,
+        const ee_limbs_tree_t *tree, ee_size_t level, ee_size_t index)
+{
+    ee_size_t width = ee_limbs_width_s(ctx->sigma, level);
+    const ee_limb_t *limbs = tree->levels[level] + index * width;
+
+    while (0 < width && 0 == limbs[width - 1]) {
+        width -= 1;
+    }
+
+    for (ee_size_t i = 0; i < width; ++i) {
+        r->limbs[i] = limbs[i];
+    }
+
+    r->size = width;
+}
+
+static void
+ee_limbs_tree_set_s(ee_numeration_ctx_t *ctx, ee_limbs_tree_t *tree,
+        ee_size_t level, ee_size_t index, const ee_limbs_t *a)
+{
+    ee_size_t width = ee_limbs_width_s(ctx->sigma, level);
+    ee_limb_t *limbs = tree->levels[level] + index * width;
 
-    for (ee_size_t j = ch + 1; j <= EE_ALPHABET_SIZE; ++j) {
-        thetas[j] -= 1;
+    for (ee_size_t i = 0; i < width; ++i) {
+        limbs[i] = (i < a->size) ? a->limbs[i] : 0;
     }
 }
@@ -1,12 +1,36 @@
 #ifndef NUMERATION_H
 #define	NUMERATION_H
 
+#include <stdint.h>
 #include <gmp.h>
 
 #include "common.h"
 #include "block.h"
 #include "statistics.h"
 
+/*
+ * Nearly every block of a run is 2^sigma symbols long, so one delta tree
+ * serves them and the other takes the shorter last blocks of the sources.
+ */
+#define EE_DELTA_CACHE_SIZE 2
+#define EE_FACTORIALS_MAX 256
+
+/*
+ * The lower levels of the trees, where the numbers are only a few limbs long,
+ * are kept in fixed-capacity numbers instead of mpz_t, so that they are
+ * multiplied and divided in place without GMP's call and normalization
+ * overhead.  Each limb is half of the widest native word, so that limb
+ * products are exact.
+ */
+#ifdef __SIZEOF_INT128__
+typedef uint64_t ee_limb_t;
+#else
+typedef uint32_t ee_limb_t;
+#endif
+
+#define EE_LIMB_BITS (sizeof(ee_limb_t) * EE_BITS_IN_BYTE)
+#define EE_LIMBS_MAX (512 / EE_LIMB_BITS)
+
 typedef struct ee_number_s {
     mpz_t eta;
     mpz_t delta;
@@ -18,6 +42,77 @@ typedef struct ee_subnumber_s {
     ee_size_t subnum_bit_length;
 } ee_subnumber_t;
 
+/*
+ * All levels of a 2^sigma-leaf product tree in one allocation: levels[0] are
+ * the leaves, levels[sigma][0] is the root, and each level directly follows
+ * the one below it in items.  Only the first cols[i] nodes of level i are
+ * initialized; the others are set up when a block first reaches them.
+ */
+typedef struct ee_mpz_tree_s {
+    mpz_t **levels;
+    ee_size_t *cols;
+    mpz_t *items;
+} ee_mpz_tree_t;
+
+/*
+ * A nonnegative number of at most EE_LIMBS_MAX limbs, least significant limb
+ * first; size is the number of significant limbs, so zero has none.
+ */
+typedef struct ee_limbs_s {
+    ee_size_t size;
+    ee_limb_t limbs[EE_LIMBS_MAX];
+} ee_limbs_t;
+
+/*
+ * Levels 0..ctx->limbs_level of a product tree, laid out as ee_mpz_tree_t.
+ * A node of level i takes the ceil(2^i * (sigma + 1) / EE_LIMB_BITS) limbs
+ * that its number can need, least significant first and padded with zero
+ * limbs, and is loaded into an ee_limbs_t to be computed with.
+ */
+typedef struct ee_limbs_tree_s {
+    ee_limb_t **levels;
+    ee_limb_t *items;
+} ee_limbs_tree_t;
+
+typedef struct ee_delta_cache_item_s {
+    ee_size_t length;
+    ee_size_t stamp;
+    ee_mpz_tree_t tree;
+    ee_limbs_tree_t limbs;
+    ee_bool_t tree_complete;
+} ee_delta_cache_item_t;
+
+typedef struct ee_numeration_ctx_s {
+    ee_size_t sigma;
+    ee_size_t size;
+    ee_size_t length;
+    ee_mpz_tree_t rho;
+    ee_mpz_tree_t theta;
+    ee_size_t limbs_level;
+    ee_limbs_t *rho_limbs;
+    ee_limbs_t *theta_limbs;
+    ee_limbs_t *z_limbs;
+    ee_limbs_t *rem_limbs;
+    ee_limbs_t *excess_limbs;
+    ee_limbs_t *delta_limbs;
+    ee_int_t *thetas;
+    ee_int_t *counts;
+    mpz_t *z;
+    mpz_t *rem;
+    mpz_t *excess;
+    ee_delta_cache_item_t delta_cache[EE_DELTA_CACHE_SIZE];
+    ee_size_t delta_cache_tick;
+    mpz_t *factorials;
+    ee_size_t factorials_count;
+    mpz_t tmp1;
+    mpz_t tmp2;
+} ee_numeration_ctx_t;
+
+ee_int_t
+ee_numeration_ctx_init(ee_numeration_ctx_t *ctx, ee_size_t sigma);
+void
+ee_numeration_ctx_deinit(ee_numeration_ctx_t *ctx);
+
 void
 ee_number_init(ee_number_t *number);
 void
@@ -28,24 +123,27 @@ ee_subnumber_init(ee_subnumber_t *subnumber);
 void
 ee_subnumber_deinit(ee_subnumber_t *subnumber);
 
-ee_int_t
-ee_number_eval(ee_number_t *number, ee_block_t *block,
-        ee_statistics_t *statistics);
 void
-ee_subnumber_eval(ee_subnumber_t *subnumber, ee_number_t *number);
+ee_number_eval(ee_numeration_ctx_t *ctx, ee_number_t *number,
+        ee_block_t *block, ee_statistics_t *statistics);
+void
+ee_subnumber_eval(ee_numeration_ctx_t *ctx, ee_subnumber_t *subnumber,
+        ee_number_t *number);
 
-ee_int_t
-ee_eval_rho(mpz_t out_rho, ee_block_t *block, ee_statistics_t *statistics);
-ee_int_t
-ee_eval_delta(mpz_t out_delta, mpz_t rho, ee_block_t *block,
+void
+ee_eval_rho_delta(ee_numeration_ctx_t *ctx, mpz_t out_rho, mpz_t out_delta,
+        ee_block_t *block, ee_statistics_t *statistics);
+void
+ee_eval_rho(ee_numeration_ctx_t *ctx, mpz_t out_rho, ee_block_t *block,
         ee_statistics_t *statistics);
 void
 ee_eval_subnum_bit_length(ee_size_t *subnum_bit_length, mpz_t delta,
         ee_int_t subset);
 void
-ee_number_restore(ee_number_t *number, mpz_t delta, ee_subnumber_t *subnumber);
-ee_int_t
-ee_block_restore(ee_block_t *block, ee_statistics_t *statistics, mpz_t rho,
-        ee_number_t *number);
+ee_number_restore(ee_numeration_ctx_t *ctx, ee_number_t *number, mpz_t delta,
+        ee_subnumber_t *subnumber);
+void
+ee_block_restore(ee_numeration_ctx_t *ctx, ee_block_t *block,
+        ee_statistics_t *statistics, mpz_t rho, ee_number_t *number);
 
 #endif /* NUMERATION_H */
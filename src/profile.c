@@ -0,0 +1,178 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <gmp.h>
+
+#include "profile.h"
+
+#include "common.h"
+
+#define EE_PROFILE_NS_IN_S 1000000000.0
+
+typedef struct ee_profile_s {
+    ee_bool_t enabled;
+    pthread_mutex_t mutex;
+    uint64_t ns[EE_PROFILE_STAGES_NUMBER];
+    uint64_t counters[EE_PROFILE_COUNTERS_NUMBER];
+    void *(*mpz_alloc)(size_t);
+    void *(*mpz_realloc)(void *, size_t, size_t);
+} ee_profile_t;
+
+static ee_profile_t ee_profile = {
+    .enabled = EE_FALSE,
+    .mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+static const char *ee_profile_stage_names_s[EE_PROFILE_STAGES_NUMBER] = {
+    "read",
+    "split",
+    "numerate",
+    "serialize",
+    "write",
+    "parse",
+    "restore",
+    "merge"
+};
+
+static const char *ee_profile_counter_names_s[EE_PROFILE_COUNTERS_NUMBER] = {
+    "blocks",
+    "sources",
+    "pub_bits",
+    "pri_bits",
+    "mpz_bytes",
+    "mpz_allocs",
+    "bytes_read"
+};
+
+static void *
+ee_profile_mpz_alloc_s(size_t size);
+static void *
+ee_profile_mpz_realloc_s(void *ptr, size_t old_size, size_t new_size);
+
+void
+ee_profile_enable(void)
+{
+    mp_get_memory_functions(&(ee_profile.mpz_alloc), &(ee_profile.mpz_realloc),
+            NULL);
+    mp_set_memory_functions(ee_profile_mpz_alloc_s, ee_profile_mpz_realloc_s,
+            NULL);
+    ee_profile.enabled = EE_TRUE;
+}
+
+uint64_t
+ee_profile_start(void)
+{
+    struct timespec ts;
+
+    if (EE_FALSE == ee_profile.enabled) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void
+ee_profile_stop(ee_profile_stage_t stage, uint64_t start)
+{
+    uint64_t stop;
+
+    if (EE_FALSE == ee_profile.enabled) {
+        return;
+    }
+
+    stop = ee_profile_start();
+    pthread_mutex_lock(&(ee_profile.mutex));
+    ee_profile.ns[stage] += stop - start;
+    pthread_mutex_unlock(&(ee_profile.mutex));
+}
+
+void
+ee_profile_count(ee_profile_counter_t counter, uint64_t value)
+{
+    if (EE_FALSE == ee_profile.enabled) {
+        return;
+    }
+
+    pthread_mutex_lock(&(ee_profile.mutex));
+    ee_profile.counters[counter] += value;
+    pthread_mutex_unlock(&(ee_profile.mutex));
+}
+
+uint64_t
+ee_profile_value(ee_profile_counter_t counter)
+{
+    uint64_t value;
+
+    pthread_mutex_lock(&(ee_profile.mutex));
+    value = ee_profile.counters[counter];
+    pthread_mutex_unlock(&(ee_profile.mutex));
+
+    return value;
+}
+
+void
+ee_profile_print(FILE *file, ee_int_t format)
+{
+    if (EE_FALSE == ee_profile.enabled) {
+        return;
+    }
+
+    if (EE_PROFILE_FORMAT_JSON == format) {
+        fprintf(file, "{\"stages\": {");
+        for (ee_size_t i = 0; i < EE_PROFILE_STAGES_NUMBER; ++i) {
+            fprintf(file, "%s\"%s\": %.6f", (0 == i) ? "" : ", ",
+                    ee_profile_stage_names_s[i],
+                    ee_profile.ns[i] / EE_PROFILE_NS_IN_S);
+        }
+
+        fprintf(file, "}, \"counters\": {");
+        for (ee_size_t i = 0; i < EE_PROFILE_COUNTERS_NUMBER; ++i) {
+            fprintf(file, "%s\"%s\": %llu", (0 == i) ? "" : ", ",
+                    ee_profile_counter_names_s[i],
+                    (unsigned long long)ee_profile.counters[i]);
+        }
+
+        fprintf(file, "}}\n");
+        return;
+    }
+
+    fprintf(file, "stage         seconds\n");
+    for (ee_size_t i = 0; i < EE_PROFILE_STAGES_NUMBER; ++i) {
+        fprintf(file, "%-12s  %.6f\n", ee_profile_stage_names_s[i],
+                ee_profile.ns[i] / EE_PROFILE_NS_IN_S);
+    }
+
+    fprintf(file, "counter       value\n");
+    for (ee_size_t i = 0; i < EE_PROFILE_COUNTERS_NUMBER; ++i) {
+        fprintf(file, "%-12s  %llu\n", ee_profile_counter_names_s[i],
+                (unsigned long long)ee_profile.counters[i]);
+    }
+}
+
+static void *
+ee_profile_mpz_alloc_s(size_t size)
+{
+    ee_profile_count(EE_PROFILE_MPZ_BYTES, size);
+    ee_profile_count(EE_PROFILE_MPZ_ALLOCS, 1);
+
+    return ee_profile.mpz_alloc(size);
+}
+
+static void *
+ee_profile_mpz_realloc_s(void *ptr, size_t old_size, size_t new_size)
+{
+    if (new_size > old_size) {
+        ee_profile_count(EE_PROFILE_MPZ_BYTES, new_size - old_size);
+        ee_profile_count(EE_PROFILE_MPZ_ALLOCS, 1);
+    }
+
+    return ee_profile.mpz_realloc(ptr, old_size, new_size);
+}
@@ -0,0 +1,53 @@
+#ifndef PROFILE_H
+#define	PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "common.h"
+
+#define EE_PROFILE_FORMAT_TEXT 0
+#define EE_PROFILE_FORMAT_JSON 1
+
+typedef enum ee_profile_stage_e {
+    EE_PROFILE_READ,
+    EE_PROFILE_SPLIT,
+    EE_PROFILE_NUMERATE,
+    EE_PROFILE_SERIALIZE,
+    EE_PROFILE_WRITE,
+    EE_PROFILE_PARSE,
+    EE_PROFILE_RESTORE,
+    EE_PROFILE_MERGE,
+    EE_PROFILE_STAGES_NUMBER
+} ee_profile_stage_t;
+
+typedef enum ee_profile_counter_e {
+    EE_PROFILE_BLOCKS,
+    EE_PROFILE_SOURCES,
+    EE_PROFILE_PUB_BITS,
+    EE_PROFILE_PRI_BITS,
+    EE_PROFILE_MPZ_BYTES,
+    EE_PROFILE_MPZ_ALLOCS,
+    EE_PROFILE_BYTES_READ,
+    EE_PROFILE_COUNTERS_NUMBER
+} ee_profile_counter_t;
+
+/*
+ * Process-wide stage timings and counters.  Until ee_profile_enable is
+ * called every function below returns at once, so the hooks cost one branch.
+ * Timings of stages run by several threads are summed over the threads.
+ */
+void
+ee_profile_enable(void);
+uint64_t
+ee_profile_start(void);
+void
+ee_profile_stop(ee_profile_stage_t stage, uint64_t start);
+void
+ee_profile_count(ee_profile_counter_t counter, uint64_t value);
+uint64_t
+ee_profile_value(ee_profile_counter_t counter);
+void
+ee_profile_print(FILE *file, ee_int_t format);
+
+#endif /* PROFILE_H */
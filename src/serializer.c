@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <gmp.h>
 
@@ -7,6 +8,131 @@
 #include "bits.h"
 #include "util.h"
 
+/* One kernel per item width sigma + 1, sigma being at most 16. */
+#define EE_STATISTICS_ITEM_SIZE_MAX 17
+
+#define EE_STATISTICS_KERNELS(width) \
+        static void \
+        ee_statistics_pack_##width##_s(ee_byte_t *bytes, \
+                const ee_int_t *stats) \
+        { \
+            uint64_t acc = 0; \
+            ee_size_t bits = 0; \
+            for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) { \
+                acc = (acc << (width)) \
+                        | (stats[i] & ((UINT64_C(1) << (width)) - 1)); \
+                bits += (width); \
+                while (EE_BITS_IN_BYTE <= bits) { \
+                    bits -= EE_BITS_IN_BYTE; \
+                    *bytes++ = (ee_byte_t)(acc >> bits); \
+                } \
+            } \
+        } \
+        \
+        static void \
+        ee_statistics_unpack_##width##_s(ee_int_t *stats, \
+                const ee_byte_t *bytes) \
+        { \
+            uint64_t acc = 0; \
+            ee_size_t bits = 0; \
+            for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) { \
+                while ((width) > bits) { \
+                    acc = (acc << EE_BITS_IN_BYTE) | *bytes++; \
+                    bits += EE_BITS_IN_BYTE; \
+                } \
+                bits -= (width); \
+                stats[i] = (ee_int_t)((acc >> bits) \
+                        & ((UINT64_C(1) << (width)) - 1)); \
+            } \
+        }
+
+typedef void ee_statistics_pack_t(ee_byte_t *bytes, const ee_int_t *stats);
+typedef void ee_statistics_unpack_t(ee_int_t *stats, const ee_byte_t *bytes);
+
+EE_STATISTICS_KERNELS(1)
+EE_STATISTICS_KERNELS(2)
+EE_STATISTICS_KERNELS(3)
+EE_STATISTICS_KERNELS(4)
+EE_STATISTICS_KERNELS(5)
+EE_STATISTICS_KERNELS(6)
+EE_STATISTICS_KERNELS(7)
+EE_STATISTICS_KERNELS(8)
+EE_STATISTICS_KERNELS(9)
+EE_STATISTICS_KERNELS(10)
+EE_STATISTICS_KERNELS(11)
+EE_STATISTICS_KERNELS(12)
+EE_STATISTICS_KERNELS(13)
+EE_STATISTICS_KERNELS(14)
+EE_STATISTICS_KERNELS(15)
+EE_STATISTICS_KERNELS(16)
+EE_STATISTICS_KERNELS(17)
+
+static ee_statistics_pack_t *const
+ee_statistics_pack_kernels_s[EE_STATISTICS_ITEM_SIZE_MAX + 1] = {
+    NULL,
+    ee_statistics_pack_1_s, ee_statistics_pack_2_s, ee_statistics_pack_3_s,
+    ee_statistics_pack_4_s, ee_statistics_pack_5_s, ee_statistics_pack_6_s,
+    ee_statistics_pack_7_s, ee_statistics_pack_8_s, ee_statistics_pack_9_s,
+    ee_statistics_pack_10_s, ee_statistics_pack_11_s, ee_statistics_pack_12_s,
+    ee_statistics_pack_13_s, ee_statistics_pack_14_s, ee_statistics_pack_15_s,
+    ee_statistics_pack_16_s, ee_statistics_pack_17_s
+};
+
+static ee_statistics_unpack_t *const
+ee_statistics_unpack_kernels_s[EE_STATISTICS_ITEM_SIZE_MAX + 1] = {
+    NULL,
+    ee_statistics_unpack_1_s, ee_statistics_unpack_2_s,
+    ee_statistics_unpack_3_s, ee_statistics_unpack_4_s,
+    ee_statistics_unpack_5_s, ee_statistics_unpack_6_s,
+    ee_statistics_unpack_7_s, ee_statistics_unpack_8_s,
+    ee_statistics_unpack_9_s, ee_statistics_unpack_10_s,
+    ee_statistics_unpack_11_s, ee_statistics_unpack_12_s,
+    ee_statistics_unpack_13_s, ee_statistics_unpack_14_s,
+    ee_statistics_unpack_15_s, ee_statistics_unpack_16_s,
+    ee_statistics_unpack_17_s
+};
+
+static ee_int_t
+ee_statistics_serialize_plain_s(ee_sdata_t *data,
+        ee_statistics_t *statistics, ee_size_t sigma);
+static void
+ee_statistics_deserialize_plain_s(ee_statistics_t *statistics,
+        ee_sdata_t *data, ee_size_t sigma);
+static ee_int_t
+ee_statistics_serialize_compact_s(ee_serializer_ctx_t *ctx, ee_sdata_t *data,
+        ee_statistics_t *statistics, ee_size_t sigma);
+static void
+ee_statistics_deserialize_compact_s(ee_serializer_ctx_t *ctx,
+        ee_statistics_t *statistics, ee_sdata_t *data, ee_size_t sigma);
+static ee_bool_t
+ee_statistics_is_compact_s(ee_sdata_t *data, ee_size_t sigma);
+static ee_size_t
+ee_statistics_rank_bit_length_s(ee_serializer_ctx_t *ctx, ee_size_t length,
+        ee_size_t present);
+
+static ee_size_t
+ee_sdata_bit_idx_s(ee_sdata_t *data, ee_size_t offset);
+static void
+ee_sdata_put_bits_s(ee_sdata_t *data, ee_size_t *offset, ee_int_t value,
+        ee_size_t bits_number);
+static ee_int_t
+ee_sdata_get_bits_s(ee_sdata_t *data, ee_size_t *offset,
+        ee_size_t bits_number);
+
+void
+ee_serializer_ctx_init(ee_serializer_ctx_t *ctx)
+{
+    mpz_init(ctx->rank);
+    mpz_init(ctx->binom);
+}
+
+void
+ee_serializer_ctx_deinit(ee_serializer_ctx_t *ctx)
+{
+    mpz_clear(ctx->binom);
+    mpz_clear(ctx->rank);
+}
+
 void
 ee_sdata_clear(ee_sdata_t *data)
 {
@@ -18,70 +144,123 @@ ee_sdata_clear(ee_sdata_t *data)
 }
 
 ee_int_t
-ee_statistics_serialize(ee_sdata_t *data, ee_statistics_t *statistics,
-        ee_size_t sigma)
+ee_sdata_reserve(ee_sdata_t *data, ee_size_t bits_number)
 {
-    ee_int_t status = EE_SUCCESS;
-    ee_size_t item_size = sigma + 1;
-    ee_size_t bytes_number;
-    ee_bit_info_t bit_info = EE_BIT_INFO_DEFAULT;
+    ee_size_t bytes_number = EE_EVAL_BYTES_NUMBER(bits_number);
 
-    data->bits_number = item_size * EE_ALPHABET_SIZE;
-    bytes_number = EE_EVAL_BYTES_NUMBER(data->bits_number);
-    data->bytes = calloc(bytes_number, sizeof(ee_byte_t));
-    if (NULL == data->bytes) {
-        status = EE_ALLOC_FAILURE;
-        goto calloc_error;
+    if (bytes_number > data->capacity) {
+        ee_byte_t *ptr = NULL;
+        ptr = realloc(data->bytes, bytes_number);
+        if (NULL == ptr) {
+            return EE_ALLOC_FAILURE;
+        }
+
+        data->bytes = ptr;
+        data->capacity = bytes_number;
     }
 
-    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
-        for (ee_size_t j = item_size; j > 0; --j) {
-            ee_size_t bit = ee_bit_get(statistics->stats[i], j - 1);
-            ee_int_t value = data->bytes[bit_info.current_byte];
-            data->bytes[bit_info.current_byte] = ee_bit_set(value,
-                    bit_info.current_bit, bit);
-            ee_bit_info_ms_inc(&bit_info);
+    ee_memset(data->bytes, 0, bytes_number);
+    data->bits_number = bits_number;
+
+    return EE_SUCCESS;
+}
+
+/*
+ * Unlike ee_sdata_reserve(), keeps the bytes already held and clears only
+ * the ones added.
+ */
+ee_int_t
+ee_sdata_grow(ee_sdata_t *data, ee_size_t bits_number)
+{
+    ee_size_t bytes_number = EE_EVAL_BYTES_NUMBER(bits_number);
+    ee_size_t used_bytes_number = EE_EVAL_BYTES_NUMBER(data->bits_number);
+
+    if (bytes_number > data->capacity) {
+        ee_byte_t *ptr = NULL;
+        ptr = realloc(data->bytes, bytes_number);
+        if (NULL == ptr) {
+            return EE_ALLOC_FAILURE;
         }
+
+        data->bytes = ptr;
+        data->capacity = bytes_number;
     }
 
-calloc_error:
-    return status;
+    if (bytes_number > used_bytes_number) {
+        ee_memset(data->bytes + used_bytes_number, 0,
+                bytes_number - used_bytes_number);
+    }
+
+    data->bits_number = bits_number;
+
+    return EE_SUCCESS;
+}
+
+ee_int_t
+ee_statistics_serialize(ee_serializer_ctx_t *ctx, ee_sdata_t *data,
+        ee_statistics_t *statistics, ee_size_t sigma, ee_int_t format)
+{
+    if (EE_STATISTICS_FORMAT_COMPACT == format) {
+        return ee_statistics_serialize_compact_s(ctx, data, statistics,
+                sigma);
+    }
+
+    return ee_statistics_serialize_plain_s(data, statistics, sigma);
 }
 
 void
-ee_statistics_deserialize(ee_statistics_t *statistics, ee_sdata_t *data,
+ee_statistics_deserialize(ee_serializer_ctx_t *ctx,
+        ee_statistics_t *statistics, ee_sdata_t *data, ee_size_t sigma)
+{
+    if (EE_TRUE == ee_statistics_is_compact_s(data, sigma)) {
+        ee_statistics_deserialize_compact_s(ctx, statistics, data, sigma);
+    } else {
+        ee_statistics_deserialize_plain_s(statistics, data, sigma);
+    }
+}
+
+ee_size_t
+ee_statistics_prefix_bit_length(ee_size_t sigma)
+{
+    return 2 * (sigma + 1) + EE_ALPHABET_SIZE;
+}
+
+ee_size_t
+ee_statistics_bit_length(ee_serializer_ctx_t *ctx, ee_sdata_t *prefix,
         ee_size_t sigma)
 {
     ee_size_t item_size = sigma + 1;
-    ee_bit_info_t bit_info = EE_BIT_INFO_DEFAULT;
+    ee_size_t offset = item_size;
+    ee_size_t length;
+    ee_size_t present = 0;
+
+    if (EE_FALSE == ee_statistics_is_compact_s(prefix, sigma)) {
+        return item_size * EE_ALPHABET_SIZE;
+    }
 
     for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
-        statistics->stats[i] = 0;
-        for (ee_size_t j = item_size; j > 0; --j) {
-            ee_size_t bit = ee_bit_get(data->bytes[bit_info.current_byte],
-                    bit_info.current_bit);
-            statistics->stats[i] = ee_bit_set(statistics->stats[i], j - 1, bit);
-            ee_bit_info_ms_inc(&bit_info);
-        }
+        present += ee_sdata_get_bits_s(prefix, &offset, 1);
     }
+
+    length = ee_sdata_get_bits_s(prefix, &offset, item_size);
+
+    return ee_statistics_prefix_bit_length(sigma)
+            + ee_statistics_rank_bit_length_s(ctx, length, present);
 }
 
 ee_int_t
 ee_mpz_serialize(ee_sdata_t *data, mpz_t mpz, ee_size_t bits_number)
 {
     ee_int_t status = EE_SUCCESS;
-    ee_size_t bytes_number = EE_EVAL_BYTES_NUMBER(bits_number);
 
-    data->bytes = calloc(bytes_number, sizeof(ee_byte_t));
-    data->bits_number = bits_number;
-    if (NULL == data->bytes) {
-        status = EE_ALLOC_FAILURE;
-        goto calloc_error;
+    status = ee_sdata_reserve(data, bits_number);
+    if (EE_SUCCESS != status) {
+        goto reserve_error;
     }
 
     mpz_export(data->bytes, NULL, -1, sizeof(ee_byte_t), -1, 0, mpz);
 
-calloc_error:
+reserve_error:
     return status;
 }
 
@@ -96,15 +275,11 @@ ee_int_t
 ee_subset_serialize(ee_sdata_t *data, ee_int_t subset, ee_size_t sigma)
 {
     ee_int_t status = EE_SUCCESS;
-    ee_size_t bytes_number;
     ee_bit_info_t bit_info = { 0, 0 };
 
-    data->bits_number = sigma + 4;
-    bytes_number = EE_EVAL_BYTES_NUMBER(data->bits_number);
-    data->bytes = calloc(bytes_number, sizeof(ee_byte_t));
-    if (NULL == data->bytes) {
-        status = EE_ALLOC_FAILURE;
-        goto calloc_error;
+    status = ee_sdata_reserve(data, sigma + 4);
+    if (EE_SUCCESS != status) {
+        goto reserve_error;
     }
 
     for (ee_size_t i = data->bits_number; i > 0; --i) {
@@ -115,7 +290,7 @@ ee_subset_serialize(ee_sdata_t *data, ee_int_t subset, ee_size_t sigma)
         ee_bit_info_ls_inc(&bit_info);
     }
 
-calloc_error:
+reserve_error:
     return status;
 }
 
@@ -134,32 +309,29 @@ ee_subset_deserialize(ee_int_t *subset, ee_sdata_t *data)
 }
 
 ee_int_t
-ee_source_info_serialize(ee_sdata_t *data, ee_source_t *source, ee_size_t mu)
+ee_source_info_serialize(ee_sdata_t *data, ee_source_t *source,
+        ee_char_t last_char, ee_size_t length, ee_size_t mu)
 {
     ee_int_t status = EE_SUCCESS;
-    ee_size_t bytes_number;
     ee_bit_info_t bit_info = EE_BIT_INFO_DEFAULT;
 
-    data->bits_number = (mu + 1 + 4) * EE_BITS_IN_BYTE;
-    bytes_number = EE_EVAL_BYTES_NUMBER(data->bits_number);
-    data->bytes = calloc(bytes_number, sizeof(ee_byte_t));
-    if (NULL == data->bytes) {
-        status = EE_ALLOC_FAILURE;
-        goto calloc_error;
+    status = ee_sdata_reserve(data, (mu + 1 + 4) * EE_BITS_IN_BYTE);
+    if (EE_SUCCESS != status) {
+        goto reserve_error;
     }
 
     memcpy(data->bytes, source->prefix, mu);
-    data->bytes[mu] = source->chars[source->length - 1];
+    data->bytes[mu] = last_char;
     bit_info.current_byte = mu + 1;
     for (ee_size_t i = 0; i < 4 * EE_BITS_IN_BYTE; ++i) {
-        ee_size_t bit = ee_bit_get(source->length, i);
+        ee_size_t bit = ee_bit_get(length, i);
         ee_int_t value = data->bytes[bit_info.current_byte];
         value = ee_bit_set(value, bit_info.current_bit, bit);
         data->bytes[bit_info.current_byte] = value;
         ee_bit_info_ms_inc(&bit_info);
     }
 
-calloc_error:
+reserve_error:
     return status;
 }
 
@@ -180,3 +352,221 @@ ee_source_info_deserialize(ee_source_t *source, ee_char_t *last_char,
         ee_bit_info_ms_inc(&bit_info);
     }
 }
+
+static ee_int_t
+ee_statistics_serialize_plain_s(ee_sdata_t *data,
+        ee_statistics_t *statistics, ee_size_t sigma)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_size_t item_size = sigma + 1;
+
+    status = ee_sdata_reserve(data, item_size * EE_ALPHABET_SIZE);
+    if (EE_SUCCESS != status) {
+        goto reserve_error;
+    }
+
+    ee_statistics_pack_kernels_s[item_size](data->bytes, statistics->stats);
+
+reserve_error:
+    return status;
+}
+
+static void
+ee_statistics_deserialize_plain_s(ee_statistics_t *statistics,
+        ee_sdata_t *data, ee_size_t sigma)
+{
+    ee_size_t item_size = sigma + 1;
+
+    ee_statistics_unpack_kernels_s[item_size](statistics->stats, data->bytes);
+}
+
+static ee_int_t
+ee_statistics_serialize_compact_s(ee_serializer_ctx_t *ctx, ee_sdata_t *data,
+        ee_statistics_t *statistics, ee_size_t sigma)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_size_t item_size = sigma + 1;
+    ee_size_t offset = 0;
+    ee_size_t length = 0;
+    ee_size_t present = 0;
+    ee_size_t rank_bit_length;
+
+    mpz_set_ui(ctx->rank, 0);
+    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
+        if (0 == statistics->stats[i]) {
+            continue;
+        }
+
+        length += statistics->stats[i];
+        present += 1;
+        if (1 < present) {
+            mpz_bin_uiui(ctx->binom, length - statistics->stats[i] - 1,
+                    present - 1);
+            mpz_add(ctx->rank, ctx->rank, ctx->binom);
+        }
+    }
+
+    rank_bit_length = ee_statistics_rank_bit_length_s(ctx, length, present);
+    status = ee_sdata_reserve(data, ee_statistics_prefix_bit_length(sigma)
+            + rank_bit_length);
+    if (EE_SUCCESS != status) {
+        goto reserve_error;
+    }
+
+    ee_sdata_put_bits_s(data, &offset, (1L << item_size) - 1, item_size);
+    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
+        ee_sdata_put_bits_s(data, &offset,
+                (0 == statistics->stats[i]) ? 0 : 1, 1);
+    }
+
+    ee_sdata_put_bits_s(data, &offset, length, item_size);
+    for (ee_size_t i = rank_bit_length; i > 0; --i) {
+        ee_sdata_put_bits_s(data, &offset, mpz_tstbit(ctx->rank, i - 1),
+                1);
+    }
+
+reserve_error:
+    return status;
+}
+
+static void
+ee_statistics_deserialize_compact_s(ee_serializer_ctx_t *ctx,
+        ee_statistics_t *statistics, ee_sdata_t *data, ee_size_t sigma)
+{
+    ee_size_t item_size = sigma + 1;
+    ee_size_t offset = item_size;
+    ee_size_t symbols[EE_ALPHABET_SIZE];
+    ee_size_t sums[EE_ALPHABET_SIZE];
+    ee_size_t length;
+    ee_size_t present = 0;
+    ee_size_t rank_bit_length;
+    ee_size_t upper;
+
+    ee_memset(statistics->stats, 0, sizeof(statistics->stats));
+    for (ee_size_t i = 0; i < EE_ALPHABET_SIZE; ++i) {
+        if (1 == ee_sdata_get_bits_s(data, &offset, 1)) {
+            symbols[present++] = i;
+        }
+    }
+
+    length = ee_sdata_get_bits_s(data, &offset, item_size);
+    if (0 == present) {
+        return;
+    }
+
+    rank_bit_length = ee_statistics_rank_bit_length_s(ctx, length, present);
+    mpz_set_ui(ctx->rank, 0);
+    for (ee_size_t i = 0; i < rank_bit_length; ++i) {
+        mpz_mul_2exp(ctx->rank, ctx->rank, 1);
+        if (1 == ee_sdata_get_bits_s(data, &offset, 1)) {
+            mpz_add_ui(ctx->rank, ctx->rank, 1);
+        }
+    }
+
+    /*
+     * Partial sums of the counts, less one, form a (present - 1)-subset
+     * of [0; length - 2]; the rank is its index in the combinatorial number
+     * system, so every element is the greatest y with C(y, j) <= rank.
+     */
+    sums[present - 1] = length;
+    upper = length - 1;
+    for (ee_size_t j = present - 1; j > 0; --j) {
+        ee_size_t lo = j - 1;
+        ee_size_t hi = upper - 1;
+        while (lo < hi) {
+            ee_size_t mid = hi - (hi - lo) / 2;
+            mpz_bin_uiui(ctx->binom, mid, j);
+            if (0 >= mpz_cmp(ctx->binom, ctx->rank)) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+
+        mpz_bin_uiui(ctx->binom, lo, j);
+        mpz_sub(ctx->rank, ctx->rank, ctx->binom);
+        sums[j - 1] = lo + 1;
+        upper = lo;
+    }
+
+    statistics->stats[symbols[0]] = sums[0];
+    for (ee_size_t j = 1; j < present; ++j) {
+        statistics->stats[symbols[j]] = sums[j] - sums[j - 1];
+    }
+}
+
+static ee_bool_t
+ee_statistics_is_compact_s(ee_sdata_t *data, ee_size_t sigma)
+{
+    ee_size_t item_size = sigma + 1;
+    ee_size_t offset = 0;
+
+    return (ee_sdata_get_bits_s(data, &offset, item_size)
+            == (1L << item_size) - 1) ? EE_TRUE : EE_FALSE;
+}
+
+static ee_size_t
+ee_statistics_rank_bit_length_s(ee_serializer_ctx_t *ctx, ee_size_t length,
+        ee_size_t present)
+{
+    ee_size_t result = 0;
+
+    if (1 >= present) {
+        return 0;
+    }
+
+    mpz_bin_uiui(ctx->binom, length - 1, present - 1);
+    mpz_sub_ui(ctx->binom, ctx->binom, 1);
+    if (0 != mpz_sgn(ctx->binom)) {
+        result = mpz_sizeinbase(ctx->binom, 2);
+    }
+
+    return result;
+}
+
+/*
+ * ee_file_write_bits() takes the bits of a partial last byte from its low
+ * end, so a record read back only in part ends in a byte laid out differently
+ * from the same byte of the whole record.
+ */
+static ee_size_t
+ee_sdata_bit_idx_s(ee_sdata_t *data, ee_size_t offset)
+{
+    ee_size_t rem = data->bits_number % EE_BITS_IN_BYTE;
+
+    if (0 != rem && offset / EE_BITS_IN_BYTE
+            == data->bits_number / EE_BITS_IN_BYTE) {
+        return rem - 1 - offset % EE_BITS_IN_BYTE;
+    }
+
+    return EE_BITS_IN_BYTE - 1 - offset % EE_BITS_IN_BYTE;
+}
+
+static void
+ee_sdata_put_bits_s(ee_sdata_t *data, ee_size_t *offset, ee_int_t value,
+        ee_size_t bits_number)
+{
+    for (ee_size_t i = bits_number; i > 0; --i) {
+        ee_size_t byte_idx = *offset / EE_BITS_IN_BYTE;
+        ee_int_t byte = data->bytes[byte_idx];
+        data->bytes[byte_idx] = ee_bit_set(byte,
+                ee_sdata_bit_idx_s(data, *offset), ee_bit_get(value, i - 1));
+        *offset += 1;
+    }
+}
+
+static ee_int_t
+ee_sdata_get_bits_s(ee_sdata_t *data, ee_size_t *offset,
+        ee_size_t bits_number)
+{
+    ee_int_t value = 0;
+
+    for (ee_size_t i = 0; i < bits_number; ++i) {
+        ee_byte_t byte = data->bytes[*offset / EE_BITS_IN_BYTE];
+        value = (value << 1) | ee_bit_get(byte,
+                ee_sdata_bit_idx_s(data, *offset));
+        *offset += 1;
+    }
+
+    return value;
+}
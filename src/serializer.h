@@ -8,19 +8,50 @@
 #include "numeration.h"
 #include "splitter.h"
 
+#define EE_SDATA_DEFAULT \
+        { \
+            .bytes = NULL, \
+            .bits_number = 0, \
+            .capacity = 0 \
+        }
+
+#define EE_STATISTICS_FORMAT_PLAIN 0
+#define EE_STATISTICS_FORMAT_COMPACT 1
+
 typedef struct ee_sdata_s {
     ee_byte_t *bytes;
     ee_size_t bits_number;
+    ee_size_t capacity;
 } ee_sdata_t;
 
+/* Scratch of the compact statistics format, kept across blocks. */
+typedef struct ee_serializer_ctx_s {
+    mpz_t rank;
+    mpz_t binom;
+} ee_serializer_ctx_t;
+
+void
+ee_serializer_ctx_init(ee_serializer_ctx_t *ctx);
+void
+ee_serializer_ctx_deinit(ee_serializer_ctx_t *ctx);
+
 void
 ee_sdata_clear(ee_sdata_t *bits);
+ee_int_t
+ee_sdata_reserve(ee_sdata_t *data, ee_size_t bits_number);
+ee_int_t
+ee_sdata_grow(ee_sdata_t *data, ee_size_t bits_number);
 
 ee_int_t
-ee_statistics_serialize(ee_sdata_t *data, ee_statistics_t *statistics,
-        ee_size_t sigma);
+ee_statistics_serialize(ee_serializer_ctx_t *ctx, ee_sdata_t *data,
+        ee_statistics_t *statistics, ee_size_t sigma, ee_int_t format);
 void
-ee_statistics_deserialize(ee_statistics_t *statistics, ee_sdata_t *data,
+ee_statistics_deserialize(ee_serializer_ctx_t *ctx,
+        ee_statistics_t *statistics, ee_sdata_t *data, ee_size_t sigma);
+ee_size_t
+ee_statistics_prefix_bit_length(ee_size_t sigma);
+ee_size_t
+ee_statistics_bit_length(ee_serializer_ctx_t *ctx, ee_sdata_t *prefix,
         ee_size_t sigma);
 
 ee_int_t
@@ -34,7 +65,8 @@ void
 ee_subset_deserialize(ee_int_t *subset, ee_sdata_t *data);
 
 ee_int_t
-ee_source_info_serialize(ee_sdata_t *data, ee_source_t *source, ee_size_t mu);
+ee_source_info_serialize(ee_sdata_t *data, ee_source_t *source,
+        ee_char_t last_char, ee_size_t length, ee_size_t mu);
 void
 ee_source_info_deserialize(ee_source_t *source, ee_char_t *last_char,
         ee_size_t *length, ee_sdata_t *data, ee_size_t mu);
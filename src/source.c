@@ -6,18 +6,31 @@
 #include "util.h"
 
 #define EE_CAPACITY_QUANT 256
+#define EE_SOURCE_HASH_BASE 0x01000193UL
+#define EE_SOURCE_HASH_MIX 0x9E3779B1UL
+#define EE_SOURCE_HASH_BITS (sizeof(ee_source_hash_t) * CHAR_BIT)
+#define EE_SOURCE_TABLE_SIZE_MIN 16
+
+static ee_int_t
+ee_source_grow_s(ee_source_t *source, ee_size_t capacity);
+
+static ee_int_t
+ee_source_list_table_insert_s(ee_source_list_t *list, ee_source_t *source);
+static ee_size_t
+ee_source_list_table_index_s(ee_source_list_t *list, ee_source_hash_t hash);
+static ee_int_t
+ee_source_list_direct_insert_s(ee_source_list_t *list, ee_source_t *source);
 
 static void
 ee_source_list_clear_helper_s(ee_source_list_node_t *node);
 static ee_source_list_node_t *
 ee_source_list_insert_helper_s(ee_source_list_t *list,
         ee_source_list_node_t *root, ee_source_list_node_t *node);
-static ee_source_t *
-ee_source_list_find_helper_s(ee_source_list_node_t *node, ee_size_t mu,
-        const ee_char_t *window_start);
 static ee_bool_t
 ee_source_list_eval_message_length_handler_s(ee_source_t *source, void *context);
 static ee_bool_t
+ee_source_list_allocate_handler_s(ee_source_t *source, void *context);
+static ee_bool_t
 ee_source_list_traverse_helper_s(ee_source_list_node_t *node,
         ee_traverse_handler_t *handler, void *context);
 
@@ -38,18 +51,14 @@ ee_source_list_balance_s(ee_source_list_node_t *root);
 ee_int_t
 ee_source_init(ee_source_t *source, const ee_char_t *prefix, ee_size_t mu)
 {
-    source->capacity = EE_CAPACITY_QUANT;
+    source->capacity = 0;
     source->length = 0;
-    source->chars = calloc(source->capacity, sizeof(*(source->chars)));
-    if (NULL == source->chars) {
-        return EE_ALLOC_FAILURE;
-    }
-
-    source->current_char = source->chars;
+    source->chars = NULL;
+    source->current_char = NULL;
+    source->borrowed = EE_FALSE;
 
     source->prefix = calloc(mu, sizeof(*(source->prefix)));
     if (NULL == source->prefix) {
-        free(source->chars);
         return EE_ALLOC_FAILURE;
     }
 
@@ -64,23 +73,36 @@ void
 ee_source_deinit(ee_source_t *source)
 {
     free(source->prefix);
-    free(source->chars);
+    if (EE_FALSE == source->borrowed) {
+        free(source->chars);
+    }
+
     ee_memset(source, 0, sizeof(*source));
 }
 
+ee_int_t
+ee_source_reserve(ee_source_t *source, ee_size_t capacity)
+{
+    if (capacity > source->capacity) {
+        return ee_source_grow_s(source, capacity);
+    }
+
+    return EE_SUCCESS;
+}
+
 ee_int_t
 ee_source_append_char(ee_source_t *source, ee_char_t ch)
 {
     if (source->length == source->capacity) {
-        ee_char_t *ptr = NULL;
-        source->capacity += EE_CAPACITY_QUANT;
-        ptr = realloc(source->chars, source->capacity);
-        if (NULL == ptr) {
-            return EE_ALLOC_FAILURE;
+        ee_size_t capacity = 2 * source->capacity;
+        if (EE_CAPACITY_QUANT > capacity) {
+            capacity = EE_CAPACITY_QUANT;
         }
 
-        source->chars = ptr;
-        source->current_char = source->chars;
+        ee_int_t status = ee_source_grow_s(source, capacity);
+        if (EE_SUCCESS != status) {
+            return status;
+        }
     }
 
     source->chars[source->length] = ch;
@@ -133,6 +155,19 @@ ee_source_list_init(ee_source_list_t *list, ee_size_t mu)
     list->mu = mu;
     list->first = NULL;
     list->root = NULL;
+    list->table = NULL;
+    list->table_size = 0;
+    list->table_shift = 0;
+    list->sources_number = 0;
+    list->arena = NULL;
+
+    list->direct = (EE_SOURCE_DIRECT_MU_MAX >= mu) ? EE_TRUE : EE_FALSE;
+    list->hash_base = (EE_TRUE == list->direct)
+            ? EE_ALPHABET_SIZE : EE_SOURCE_HASH_BASE;
+    list->hash_power = 1;
+    for (ee_size_t i = 0; i < mu; ++i) {
+        list->hash_power *= list->hash_base;
+    }
 }
 
 void
@@ -145,24 +180,57 @@ ee_source_list_deinit(ee_source_list_t *list)
 void
 ee_source_list_clear(ee_source_list_t *list)
 {
-    ee_source_deinit(list->first);
-    free(list->first);
+    if (EE_TRUE == list->direct) {
+        for (ee_size_t i = 0; i < list->table_size; ++i) {
+            if (NULL != list->table[i]) {
+                ee_source_deinit(list->table[i]);
+                free(list->table[i]);
+            }
+        }
+    } else if (NULL != list->first) {
+        ee_source_deinit(list->first);
+        free(list->first);
+    }
+
     ee_source_list_clear_helper_s(list->root);
+    free(list->table);
+    free(list->arena);
+    list->first = NULL;
+    list->root = NULL;
+    list->table = NULL;
+    list->table_size = 0;
+    list->table_shift = 0;
+    list->sources_number = 0;
+    list->arena = NULL;
 }
 
 ee_int_t
 ee_source_list_insert(ee_source_list_t *list, ee_source_t *source)
 {
-    if (NULL == list->first) {
-        list->first = source;
-    } else {
-        ee_source_list_node_t *node = NULL;
+    ee_int_t status;
+    ee_source_list_node_t *node = NULL;
 
+    if (EE_TRUE == list->direct) {
+        return ee_source_list_direct_insert_s(list, source);
+    }
+
+    if (NULL != list->first) {
         node = calloc(1, sizeof(*node));
         if (NULL == node) {
             return EE_ALLOC_FAILURE;
         }
+    }
+
+    source->hash = ee_source_list_hash(list, source->prefix);
+    status = ee_source_list_table_insert_s(list, source);
+    if (EE_SUCCESS != status) {
+        free(node);
+        return status;
+    }
 
+    if (NULL == list->first) {
+        list->first = source;
+    } else {
         node->source = source;
         node->height = 1;
         list->root = ee_source_list_insert_helper_s(list, list->root, node);
@@ -171,21 +239,83 @@ ee_source_list_insert(ee_source_list_t *list, ee_source_t *source)
     return EE_SUCCESS;
 }
 
+ee_int_t
+ee_source_list_allocate(ee_source_list_t *list)
+{
+    ee_char_t *cursor;
+    ee_size_t length;
+
+    if (NULL == list->first) {
+        return EE_SUCCESS;
+    }
+
+    length = ee_source_list_eval_message_length(list) - list->mu;
+    free(list->arena);
+    list->arena = calloc(length + 1, sizeof(*(list->arena)));
+    if (NULL == list->arena) {
+        return EE_ALLOC_FAILURE;
+    }
+
+    cursor = list->arena;
+    ee_source_list_traverse(list, ee_source_list_allocate_handler_s, &cursor);
+
+    return EE_SUCCESS;
+}
+
 ee_source_t *
 ee_source_list_find(ee_source_list_t *list, const ee_char_t *window_start)
 {
-    ee_source_t *result = NULL;
+    return ee_source_list_find_hashed(list, window_start,
+            ee_source_list_hash(list, window_start));
+}
+
+ee_source_t *
+ee_source_list_find_hashed(ee_source_list_t *list,
+        const ee_char_t *window_start, ee_source_hash_t hash)
+{
+    ee_size_t mask = list->table_size - 1;
+    ee_size_t index;
 
-    if (NULL != list->first) {
-        if (0 == memcmp(window_start, list->first->prefix, list->mu)) {
-            result = list->first;
-        } else {
-            result = ee_source_list_find_helper_s(list->root, list->mu,
-                    window_start);
+    if (EE_TRUE == list->direct) {
+        return (hash < list->table_size) ? list->table[hash] : NULL;
+    }
+
+    if (0 == list->table_size) {
+        return NULL;
+    }
+
+    index = ee_source_list_table_index_s(list, hash);
+    while (NULL != list->table[index]) {
+        ee_source_t *source = list->table[index];
+        if (hash == source->hash
+                && 0 == memcmp(window_start, source->prefix, list->mu)) {
+            return source;
         }
+
+        index = (index + 1) & mask;
     }
 
-    return result;
+    return NULL;
+}
+
+ee_source_hash_t
+ee_source_list_hash(ee_source_list_t *list, const ee_char_t *window_start)
+{
+    ee_source_hash_t hash = 0;
+
+    for (ee_size_t i = 0; i < list->mu; ++i) {
+        hash = hash * list->hash_base + window_start[i];
+    }
+
+    return hash;
+}
+
+ee_source_hash_t
+ee_source_list_rehash(ee_source_list_t *list, ee_source_hash_t hash,
+        const ee_char_t *window_start)
+{
+    return hash * list->hash_base + window_start[list->mu]
+            - window_start[0] * list->hash_power;
 }
 
 ee_size_t
@@ -203,11 +333,128 @@ void
 ee_source_list_traverse(ee_source_list_t *list, ee_traverse_handler_t *handler,
         void *context)
 {
-    if (EE_TRUE == handler(list->first, context)) {
+    if (EE_TRUE != handler(list->first, context)) {
+        return;
+    }
+
+    if (EE_TRUE == list->direct) {
+        for (ee_size_t i = 0; i < list->table_size; ++i) {
+            ee_source_t *source = list->table[i];
+            if (NULL != source && list->first != source
+                    && EE_TRUE != handler(source, context)) {
+                break;
+            }
+        }
+    } else {
         ee_source_list_traverse_helper_s(list->root, handler, context);
     }
 }
 
+static ee_int_t
+ee_source_grow_s(ee_source_t *source, ee_size_t capacity)
+{
+    ee_char_t *ptr = NULL;
+
+    if (EE_TRUE == source->borrowed) {
+        ptr = malloc(capacity);
+        if (NULL != ptr) {
+            memcpy(ptr, source->chars, source->length);
+        }
+    } else {
+        ptr = realloc(source->chars, capacity);
+    }
+
+    if (NULL == ptr) {
+        return EE_ALLOC_FAILURE;
+    }
+
+    source->capacity = capacity;
+    source->chars = ptr;
+    source->current_char = source->chars;
+    source->borrowed = EE_FALSE;
+
+    return EE_SUCCESS;
+}
+
+static ee_int_t
+ee_source_list_table_insert_s(ee_source_list_t *list, ee_source_t *source)
+{
+    ee_size_t mask;
+    ee_size_t index;
+
+    if (2 * (list->sources_number + 1) > list->table_size) {
+        ee_source_t **table = list->table;
+        ee_size_t table_size = list->table_size;
+
+        list->table_size = (0 == table_size)
+                ? EE_SOURCE_TABLE_SIZE_MIN : 2 * table_size;
+        list->table = calloc(list->table_size, sizeof(*(list->table)));
+        if (NULL == list->table) {
+            list->table = table;
+            list->table_size = table_size;
+            return EE_ALLOC_FAILURE;
+        }
+
+        list->table_shift = EE_SOURCE_HASH_BITS;
+        for (ee_size_t size = list->table_size; size > 1; size >>= 1) {
+            list->table_shift -= 1;
+        }
+
+        mask = list->table_size - 1;
+        for (ee_size_t i = 0; i < table_size; ++i) {
+            if (NULL != table[i]) {
+                index = ee_source_list_table_index_s(list, table[i]->hash);
+                while (NULL != list->table[index]) {
+                    index = (index + 1) & mask;
+                }
+
+                list->table[index] = table[i];
+            }
+        }
+
+        free(table);
+    }
+
+    mask = list->table_size - 1;
+    index = ee_source_list_table_index_s(list, source->hash);
+    while (NULL != list->table[index]) {
+        index = (index + 1) & mask;
+    }
+
+    list->table[index] = source;
+    list->sources_number += 1;
+
+    return EE_SUCCESS;
+}
+
+static ee_size_t
+ee_source_list_table_index_s(ee_source_list_t *list, ee_source_hash_t hash)
+{
+    return (ee_size_t)((hash * EE_SOURCE_HASH_MIX) >> list->table_shift);
+}
+
+static ee_int_t
+ee_source_list_direct_insert_s(ee_source_list_t *list, ee_source_t *source)
+{
+    if (NULL == list->table) {
+        list->table_size = list->hash_power;
+        list->table = calloc(list->table_size, sizeof(*(list->table)));
+        if (NULL == list->table) {
+            list->table_size = 0;
+            return EE_ALLOC_FAILURE;
+        }
+    }
+
+    source->hash = ee_source_list_hash(list, source->prefix);
+    list->table[source->hash] = source;
+    list->sources_number += 1;
+    if (NULL == list->first) {
+        list->first = source;
+    }
+
+    return EE_SUCCESS;
+}
+
 static void
 ee_source_list_clear_helper_s(ee_source_list_node_t *node)
 {
@@ -241,31 +488,29 @@ ee_source_list_insert_helper_s(ee_source_list_t *list,
     return result;
 }
 
-static ee_source_t *
-ee_source_list_find_helper_s(ee_source_list_node_t *node, ee_size_t mu,
-        const ee_char_t *window_start)
+static ee_bool_t
+ee_source_list_eval_message_length_handler_s(ee_source_t *source, void *context)
 {
-    ee_source_t *result = NULL;
-
-    if (NULL != node) {
-        ee_int_t cmp = memcmp(window_start, node->source->prefix, mu);
-
-        if (cmp < 0) {
-            result = ee_source_list_find_helper_s(node->left, mu, window_start);
-        } else if (cmp > 0) {
-            result = ee_source_list_find_helper_s(node->right, mu, window_start);
-        } else {
-            result = node->source;
-        }
-    }
+    *((ee_size_t *)context) += source->length;
 
-    return result;
+    return EE_TRUE;
 }
 
 static ee_bool_t
-ee_source_list_eval_message_length_handler_s(ee_source_t *source, void *context)
+ee_source_list_allocate_handler_s(ee_source_t *source, void *context)
 {
-    *((ee_size_t *)context) += source->length;
+    ee_char_t **cursor = context;
+
+    if (EE_FALSE == source->borrowed) {
+        free(source->chars);
+    }
+
+    source->chars = *cursor;
+    source->current_char = source->chars;
+    source->capacity = source->length;
+    source->length = 0;
+    source->borrowed = EE_TRUE;
+    *cursor += source->capacity;
 
     return EE_TRUE;
 }
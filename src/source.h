@@ -4,12 +4,18 @@
 #include "common.h"
 #include "block.h"
 
+#define EE_SOURCE_DIRECT_MU_MAX 2
+
+typedef unsigned long ee_source_hash_t;
+
 typedef struct ee_source_s {
     ee_char_t *prefix;
+    ee_source_hash_t hash;
     ee_char_t *chars;
     ee_char_t *current_char;
     ee_size_t length;
     ee_size_t capacity;
+    ee_bool_t borrowed;
 } ee_source_t;
 
 typedef struct ee_source_list_node_s {
@@ -25,6 +31,14 @@ typedef struct ee_source_list_s {
     ee_size_t mu;
     ee_source_t *first;
     ee_source_list_node_t *root;
+    ee_source_t **table;
+    ee_size_t table_size;
+    ee_size_t table_shift;
+    ee_size_t sources_number;
+    ee_bool_t direct;
+    ee_source_hash_t hash_base;
+    ee_source_hash_t hash_power;
+    ee_char_t *arena;
     /*ee_source_list_node_t *head;
     ee_source_list_node_t *tail;*/
 } ee_source_list_t;
@@ -36,6 +50,8 @@ ee_source_init(ee_source_t *source, const ee_char_t *prefix, ee_size_t mu);
 void
 ee_source_deinit(ee_source_t *source);
 
+ee_int_t
+ee_source_reserve(ee_source_t *source, ee_size_t capacity);
 ee_int_t
 ee_source_append_char(ee_source_t *source, ee_char_t ch);
 ee_int_t
@@ -53,8 +69,18 @@ void
 ee_source_list_clear(ee_source_list_t *list);
 ee_int_t
 ee_source_list_insert(ee_source_list_t *list, ee_source_t *source);
+ee_int_t
+ee_source_list_allocate(ee_source_list_t *list);
 ee_source_t *
 ee_source_list_find(ee_source_list_t *list, const ee_char_t *window_start);
+ee_source_t *
+ee_source_list_find_hashed(ee_source_list_t *list,
+        const ee_char_t *window_start, ee_source_hash_t hash);
+ee_source_hash_t
+ee_source_list_hash(ee_source_list_t *list, const ee_char_t *window_start);
+ee_source_hash_t
+ee_source_list_rehash(ee_source_list_t *list, ee_source_hash_t hash,
+        const ee_char_t *window_start);
 ee_size_t
 ee_source_list_eval_message_length(ee_source_list_t *list);
 
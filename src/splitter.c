@@ -6,9 +6,16 @@
 #include "util.h"
 
 static ee_int_t
-ee_source_split_iter_s(ee_source_list_t *list, const ee_char_t *window_start);
+ee_source_split_presize_s(ee_source_list_t *list, ee_message_t *message);
 static ee_int_t
-ee_source_merge_iter_s(ee_char_t *ch, ee_source_list_t *list);
+ee_source_split_create_s(ee_source_list_t *list, ee_size_t index,
+        ee_size_t count);
+static ee_int_t
+ee_source_split_iter_s(ee_source_list_t *list, const ee_char_t *window_start,
+        ee_source_hash_t hash);
+static ee_int_t
+ee_source_merge_iter_s(ee_char_t *ch, ee_source_list_t *list,
+        ee_source_hash_t hash);
 
 ee_int_t
 ee_message_init(ee_message_t *message, ee_size_t length)
@@ -32,16 +39,27 @@ ee_message_deinit(ee_message_t *message)
 ee_int_t
 ee_source_split(ee_source_list_t *list, ee_message_t *message)
 {
+    ee_int_t status;
+    ee_source_hash_t hash;
     ee_char_t *wstart = NULL;
     ee_char_t *mend = message->chars + message->length;
 
+    if (EE_TRUE == list->direct && message->length > list->mu) {
+        status = ee_source_split_presize_s(list, message);
+        if (EE_SUCCESS != status) {
+            return status;
+        }
+    }
+
     wstart = message->chars;
+    hash = ee_source_list_hash(list, wstart);
     while (wstart + list->mu != mend) {
-        ee_int_t status = ee_source_split_iter_s(list, wstart);
+        status = ee_source_split_iter_s(list, wstart, hash);
         if (EE_SUCCESS != status) {
             return status;
         }
 
+        hash = ee_source_list_rehash(list, hash, wstart);
         wstart += 1;
     }
 
@@ -51,17 +69,20 @@ ee_source_split(ee_source_list_t *list, ee_message_t *message)
 ee_int_t
 ee_source_merge(ee_message_t *message, ee_source_list_t *list)
 {
+    ee_source_hash_t hash;
     ee_char_t *ch = message->chars;
     ee_char_t *mend = message->chars + message->length;
 
     memcpy(ch, list->first->prefix, list->mu);
+    hash = ee_source_list_hash(list, ch);
     ch += list->mu;
     while (ch != mend) {
-        ee_int_t status = ee_source_merge_iter_s(ch, list);
+        ee_int_t status = ee_source_merge_iter_s(ch, list, hash);
         if (EE_SUCCESS != status) {
             return status;
         }
 
+        hash = ee_source_list_rehash(list, hash, ch - list->mu);
         ch += 1;
     }
 
@@ -69,10 +90,82 @@ ee_source_merge(ee_message_t *message, ee_source_list_t *list)
 }
 
 static ee_int_t
-ee_source_split_iter_s(ee_source_list_t *list, const ee_char_t *window_start)
+ee_source_split_presize_s(ee_source_list_t *list, ee_message_t *message)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_size_t *counts = NULL;
+    ee_size_t contexts = list->hash_power;
+    ee_source_hash_t hash = ee_source_list_hash(list, message->chars);
+    ee_size_t first = hash;
+
+    counts = calloc(contexts, sizeof(*counts));
+    if (NULL == counts) {
+        return EE_ALLOC_FAILURE;
+    }
+
+    for (ee_size_t i = 0; i + list->mu < message->length; ++i) {
+        counts[hash] += 1;
+        hash = ee_source_list_rehash(list, hash, message->chars + i);
+    }
+
+    status = ee_source_split_create_s(list, first, counts[first]);
+    for (ee_size_t i = 0; i < contexts && EE_SUCCESS == status; ++i) {
+        if (0 != counts[i] && first != i) {
+            status = ee_source_split_create_s(list, i, counts[i]);
+        }
+    }
+
+    free(counts);
+
+    if (EE_SUCCESS == status) {
+        status = ee_source_list_allocate(list);
+    }
+
+    return status;
+}
+
+static ee_int_t
+ee_source_split_create_s(ee_source_list_t *list, ee_size_t index,
+        ee_size_t count)
+{
+    ee_int_t status;
+    ee_char_t prefix[EE_SOURCE_DIRECT_MU_MAX + 1];
+    ee_source_t *source;
+
+    for (ee_size_t i = list->mu; i > 0; --i) {
+        prefix[i - 1] = index & EE_BYTE_MASK;
+        index >>= EE_BITS_IN_BYTE;
+    }
+
+    source = calloc(1, sizeof(*source));
+    if (NULL == source) {
+        return EE_ALLOC_FAILURE;
+    }
+
+    status = ee_source_init(source, prefix, list->mu);
+    if (EE_SUCCESS != status) {
+        free(source);
+        return status;
+    }
+
+    status = ee_source_list_insert(list, source);
+    if (EE_SUCCESS != status) {
+        ee_source_deinit(source);
+        free(source);
+        return status;
+    }
+
+    source->length = count;
+
+    return EE_SUCCESS;
+}
+
+static ee_int_t
+ee_source_split_iter_s(ee_source_list_t *list, const ee_char_t *window_start,
+        ee_source_hash_t hash)
 {
     ee_int_t status;
-    ee_source_t *source = ee_source_list_find(list, window_start);
+    ee_source_t *source = ee_source_list_find_hashed(list, window_start, hash);
     if (NULL == source) {
         source = calloc(1, sizeof(*source));
         if (NULL == source) {
@@ -97,9 +190,11 @@ ee_source_split_iter_s(ee_source_list_t *list, const ee_char_t *window_start)
 }
 
 static ee_int_t
-ee_source_merge_iter_s(ee_char_t *ch, ee_source_list_t *list)
+ee_source_merge_iter_s(ee_char_t *ch, ee_source_list_t *list,
+        ee_source_hash_t hash)
 {
-    ee_source_t *source = ee_source_list_find(list, ch - list->mu);
+    ee_source_t *source = ee_source_list_find_hashed(list, ch - list->mu,
+            hash);
     if (NULL == source) {
         return EE_FAILURE;
     }
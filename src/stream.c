@@ -0,0 +1,690 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "stream.h"
+
+#define EE_STREAM_CHUNK_SIZE (64 * 1024)
+#define EE_STREAM_CHUNKS_MIN 64
+#define EE_STREAM_NO_CHUNK ((ee_size_t)-1)
+
+typedef struct ee_stream_spill_context_s {
+    ee_stream_t *stream;
+    ee_int_t status;
+} ee_stream_spill_context_t;
+
+static ee_int_t
+ee_stream_scan_s(ee_stream_t *stream);
+static ee_int_t
+ee_stream_count_s(ee_stream_t *stream, const ee_char_t *window_start,
+        ee_source_hash_t hash);
+static ee_int_t
+ee_stream_spill_s(ee_stream_t *stream);
+static ee_bool_t
+ee_stream_spill_handler_s(ee_source_t *source, void *context);
+static ee_int_t
+ee_stream_fill_s(ee_stream_t *stream, ee_stream_source_t *origin,
+        ee_stream_source_t *item);
+static ee_bool_t
+ee_stream_order_handler_s(ee_source_t *source, void *context);
+
+static ee_int_t
+ee_stream_source_next_char_s(ee_stream_reader_t *reader,
+        ee_stream_source_t *item, ee_char_t *ch);
+static ee_int_t
+ee_stream_source_load_s(ee_stream_reader_t *reader, ee_stream_source_t *item);
+static void
+ee_stream_lru_link_s(ee_stream_reader_t *reader, ee_stream_source_t *item);
+static void
+ee_stream_lru_unlink_s(ee_stream_reader_t *reader, ee_stream_source_t *item);
+static void
+ee_stream_lru_evict_s(ee_stream_reader_t *reader);
+
+ee_stream_source_t *
+ee_stream_source_create(const ee_char_t *prefix, ee_size_t mu)
+{
+    ee_stream_source_t *item = calloc(1, sizeof(*item));
+    if (NULL == item) {
+        return NULL;
+    }
+
+    item->source.prefix = calloc(mu, sizeof(*(item->source.prefix)));
+    if (NULL == item->source.prefix) {
+        free(item);
+        return NULL;
+    }
+
+    if (NULL != prefix) {
+        memcpy(item->source.prefix, prefix, mu);
+    }
+
+    return item;
+}
+
+void
+ee_stream_source_destroy(ee_stream_source_t *item)
+{
+    ee_source_deinit(&(item->source));
+    free(item);
+}
+
+ee_int_t
+ee_stream_init(ee_stream_t *stream, ee_file_t *file, ee_size_t sigma,
+        ee_size_t mu, ee_size_t window)
+{
+    ee_int_t status;
+
+    stream->file = file;
+    stream->block_size = 1 << sigma;
+    stream->window = window;
+    stream->order = NULL;
+    stream->sources_number = 0;
+    stream->next_source = 0;
+    stream->next_offset = 0;
+    stream->resident = 0;
+    stream->spill = NULL;
+    stream->spill_length = 0;
+    stream->chunks = NULL;
+    stream->chunks_number = 0;
+    stream->chunks_capacity = 0;
+    ee_source_list_init(&(stream->sources), mu);
+
+    stream->buffer = calloc(mu + EE_STREAM_CHUNK_SIZE,
+            sizeof(*(stream->buffer)));
+    if (NULL == stream->buffer) {
+        status = EE_ALLOC_FAILURE;
+        goto buffer_calloc_error;
+    }
+
+    status = ee_stream_scan_s(stream);
+    if (EE_SUCCESS != status) {
+        goto scan_error;
+    }
+
+    /*
+     * Once anything is spilled the rest follows, so that the slices have the
+     * whole window to themselves.
+     */
+    if (NULL != stream->spill) {
+        status = ee_stream_spill_s(stream);
+        if (EE_SUCCESS != status) {
+            goto scan_error;
+        }
+    }
+
+    if (0 != stream->sources_number) {
+        stream->order = calloc(stream->sources_number,
+                sizeof(*(stream->order)));
+        if (NULL == stream->order) {
+            status = EE_ALLOC_FAILURE;
+            goto order_calloc_error;
+        }
+
+        ee_source_list_traverse(&(stream->sources), ee_stream_order_handler_s,
+                stream);
+        stream->next_source = 0;
+    }
+
+    return EE_SUCCESS;
+
+order_calloc_error:
+scan_error:
+    if (NULL != stream->spill) {
+        fclose(stream->spill);
+    }
+
+    free(stream->chunks);
+    ee_source_list_deinit(&(stream->sources));
+    free(stream->buffer);
+buffer_calloc_error:
+    return status;
+}
+
+void
+ee_stream_deinit(ee_stream_t *stream)
+{
+    if (NULL != stream->spill) {
+        fclose(stream->spill);
+    }
+
+    free(stream->chunks);
+    ee_source_list_deinit(&(stream->sources));
+    free(stream->order);
+    free(stream->buffer);
+}
+
+ee_int_t
+ee_stream_next_slice(ee_stream_t *stream, ee_source_list_t *slice)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_size_t budget = stream->window;
+    ee_size_t bs = stream->block_size;
+
+    if (stream->next_source == stream->sources_number) {
+        return EE_END_OF_FILE;
+    }
+
+    while (stream->next_source < stream->sources_number) {
+        ee_stream_source_t *origin = stream->order[stream->next_source];
+        ee_stream_source_t *item;
+        ee_size_t avail = origin->total_length - stream->next_offset;
+        ee_size_t keep;
+
+        if (avail <= budget) {
+            keep = avail;
+        } else {
+            keep = (budget / bs) * bs;
+            if (0 == keep) {
+                if (NULL != slice->first) {
+                    break;
+                }
+
+                keep = bs;
+            }
+
+            keep = (keep + 1 >= avail) ? avail : keep + 1;
+        }
+
+        item = ee_stream_source_create(origin->source.prefix, slice->mu);
+        if (NULL == item) {
+            return EE_ALLOC_FAILURE;
+        }
+
+        item->total_length = origin->total_length;
+        item->last_char = origin->last_char;
+        item->skip = stream->next_offset;
+        item->keep = keep;
+        item->seen = item->skip;
+
+        status = ee_source_reserve(&(item->source), keep);
+        if (EE_SUCCESS == status) {
+            status = ee_stream_fill_s(stream, origin, item);
+        }
+
+        if (EE_SUCCESS == status) {
+            status = ee_source_list_insert(slice, &(item->source));
+        }
+
+        if (EE_SUCCESS != status) {
+            ee_stream_source_destroy(item);
+            return status;
+        }
+
+        if (keep == avail) {
+            stream->next_source += 1;
+            stream->next_offset = 0;
+            budget -= (keep < budget) ? keep : budget;
+        } else {
+            stream->next_offset += keep - 1;
+            break;
+        }
+    }
+
+    return status;
+}
+
+void
+ee_stream_reader_init(ee_stream_reader_t *reader, ee_size_t mu,
+        ee_size_t window, ee_stream_load_handler_t *load, void *context)
+{
+    ee_source_list_init(&(reader->sources), mu);
+    reader->lru_head = NULL;
+    reader->lru_tail = NULL;
+    reader->resident = 0;
+    reader->window = window;
+    reader->message_length = mu;
+    reader->load = load;
+    reader->context = context;
+}
+
+void
+ee_stream_reader_deinit(ee_stream_reader_t *reader)
+{
+    ee_source_list_deinit(&(reader->sources));
+    reader->lru_head = NULL;
+    reader->lru_tail = NULL;
+}
+
+ee_int_t
+ee_stream_reader_insert(ee_stream_reader_t *reader, ee_stream_source_t *item)
+{
+    ee_int_t status;
+
+    status = ee_source_list_insert(&(reader->sources), &(item->source));
+    if (EE_SUCCESS == status) {
+        reader->message_length += item->total_length;
+    }
+
+    return status;
+}
+
+ee_int_t
+ee_stream_merge(ee_file_t *file, ee_stream_reader_t *reader)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_source_list_t *list = &(reader->sources);
+    ee_size_t mu = list->mu;
+    ee_source_hash_t hash;
+    ee_char_t *buffer = NULL;
+    ee_size_t filled, start, remaining;
+
+    if (NULL == list->first) {
+        return EE_SUCCESS;
+    }
+
+    buffer = calloc(mu + EE_STREAM_CHUNK_SIZE, sizeof(*buffer));
+    if (NULL == buffer) {
+        return EE_ALLOC_FAILURE;
+    }
+
+    memcpy(buffer, list->first->prefix, mu);
+    hash = ee_source_list_hash(list, buffer);
+    filled = mu;
+    start = 0;
+    remaining = reader->message_length - mu;
+    while (0 < remaining) {
+        ee_stream_source_t *item;
+
+        item = (ee_stream_source_t *)ee_source_list_find_hashed(list,
+                buffer + filled - mu, hash);
+        if (NULL == item) {
+            status = EE_FAILURE;
+            break;
+        }
+
+        status = ee_stream_source_next_char_s(reader, item, buffer + filled);
+        if (EE_SUCCESS != status) {
+            break;
+        }
+
+        hash = ee_source_list_rehash(list, hash, buffer + filled - mu);
+        filled += 1;
+        remaining -= 1;
+        if (mu + EE_STREAM_CHUNK_SIZE == filled) {
+            if (filled - start != ee_file_write(file, buffer + start,
+                    filled - start)) {
+                status = file->status;
+                break;
+            }
+
+            memmove(buffer, buffer + filled - mu, mu);
+            filled = mu;
+            start = mu;
+        }
+    }
+
+    if (EE_SUCCESS == status) {
+        if (filled - start != ee_file_write(file, buffer + start,
+                filled - start)) {
+            status = file->status;
+        }
+    }
+
+    free(buffer);
+
+    return status;
+}
+
+/*
+ * Reads the input once, appending every character to its source; whenever the
+ * characters held in memory outgrow the window, they are moved to the spill
+ * file, so the input does not have to be seekable or read again.
+ */
+static ee_int_t
+ee_stream_scan_s(ee_stream_t *stream)
+{
+    ee_int_t status = EE_SUCCESS;
+    ee_source_hash_t hash;
+    ee_file_t *file = stream->file;
+    ee_size_t mu = stream->sources.mu;
+    ee_size_t filled = 0;
+
+    do {
+        ee_size_t rc = ee_file_read(stream->buffer + filled,
+                EE_STREAM_CHUNK_SIZE, file);
+        if (EE_STREAM_CHUNK_SIZE != rc && EE_END_OF_FILE != file->status) {
+            status = file->status;
+            break;
+        }
+
+        filled += rc;
+        hash = ee_source_list_hash(&(stream->sources), stream->buffer);
+        for (ee_size_t i = 0; i + mu < filled; ++i) {
+            status = ee_stream_count_s(stream, stream->buffer + i, hash);
+            if (EE_SUCCESS != status) {
+                break;
+            }
+
+            hash = ee_source_list_rehash(&(stream->sources), hash,
+                    stream->buffer + i);
+        }
+
+        if (EE_SUCCESS != status) {
+            break;
+        }
+
+        if (filled > mu) {
+            memmove(stream->buffer, stream->buffer + filled - mu, mu);
+            filled = mu;
+        }
+    } while (EE_END_OF_FILE != file->status);
+
+    return status;
+}
+
+static ee_int_t
+ee_stream_count_s(ee_stream_t *stream, const ee_char_t *window_start,
+        ee_source_hash_t hash)
+{
+    ee_int_t status;
+    ee_source_list_t *list = &(stream->sources);
+    ee_stream_source_t *item;
+    ee_size_t capacity;
+
+    item = (ee_stream_source_t *)ee_source_list_find_hashed(list,
+            window_start, hash);
+    if (NULL == item) {
+        item = ee_stream_source_create(window_start, list->mu);
+        if (NULL == item) {
+            return EE_ALLOC_FAILURE;
+        }
+
+        status = ee_source_list_insert(list, &(item->source));
+        if (EE_SUCCESS != status) {
+            ee_stream_source_destroy(item);
+            return status;
+        }
+
+        item->chunk = EE_STREAM_NO_CHUNK;
+        item->last_chunk = EE_STREAM_NO_CHUNK;
+        stream->sources_number += 1;
+    }
+
+    item->total_length += 1;
+    item->last_char = window_start[list->mu];
+
+    capacity = item->source.capacity;
+    status = ee_source_append_char(&(item->source), item->last_char);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    stream->resident += item->source.capacity - capacity;
+    if (stream->resident > stream->window) {
+        status = ee_stream_spill_s(stream);
+    }
+
+    return status;
+}
+
+/*
+ * Appends the characters every source holds in memory to the spill file as
+ * one more run of that source and frees them.
+ */
+static ee_int_t
+ee_stream_spill_s(ee_stream_t *stream)
+{
+    ee_stream_spill_context_t context;
+
+    if (NULL == stream->spill) {
+        stream->spill = tmpfile();
+        if (NULL == stream->spill) {
+            return EE_FILE_OPEN_FAILURE;
+        }
+    }
+
+    context.stream = stream;
+    context.status = EE_SUCCESS;
+    ee_source_list_traverse(&(stream->sources), ee_stream_spill_handler_s,
+            &context);
+    stream->resident = 0;
+
+    return context.status;
+}
+
+static ee_bool_t
+ee_stream_spill_handler_s(ee_source_t *source, void *context)
+{
+    ee_stream_spill_context_t *ctx = context;
+    ee_stream_t *stream = ctx->stream;
+    ee_stream_source_t *item = (ee_stream_source_t *)source;
+    ee_stream_chunk_t *chunk;
+
+    if (0 == source->length) {
+        return EE_TRUE;
+    }
+
+    if (stream->chunks_number == stream->chunks_capacity) {
+        ee_size_t capacity = 2 * stream->chunks_capacity;
+        ee_stream_chunk_t *chunks;
+
+        if (EE_STREAM_CHUNKS_MIN > capacity) {
+            capacity = EE_STREAM_CHUNKS_MIN;
+        }
+
+        chunks = realloc(stream->chunks, capacity * sizeof(*chunks));
+        if (NULL == chunks) {
+            ctx->status = EE_ALLOC_FAILURE;
+            return EE_FALSE;
+        }
+
+        stream->chunks = chunks;
+        stream->chunks_capacity = capacity;
+    }
+
+    if (source->length != fwrite(source->chars, sizeof(*(source->chars)),
+            source->length, stream->spill)) {
+        ctx->status = EE_FILE_WRITE_FAILURE;
+        return EE_FALSE;
+    }
+
+    chunk = stream->chunks + stream->chunks_number;
+    chunk->offset = stream->spill_length;
+    chunk->length = source->length;
+    chunk->next = EE_STREAM_NO_CHUNK;
+    if (EE_STREAM_NO_CHUNK == item->last_chunk) {
+        item->chunk = stream->chunks_number;
+    } else {
+        stream->chunks[item->last_chunk].next = stream->chunks_number;
+    }
+
+    item->last_chunk = stream->chunks_number;
+    stream->chunks_number += 1;
+    stream->spill_length += (long)source->length;
+
+    free(source->chars);
+    source->chars = NULL;
+    source->current_char = NULL;
+    source->length = 0;
+    source->capacity = 0;
+
+    return EE_TRUE;
+}
+
+/*
+ * Copies characters item->skip .. item->skip + item->keep - 1 of origin into
+ * item: first from the runs in the spill file, then from the characters
+ * origin still holds in memory.  Slices ask for the characters of a source in
+ * order, overlapping by at most one, so origin keeps the run it stopped at.
+ */
+static ee_int_t
+ee_stream_fill_s(ee_stream_t *stream, ee_stream_source_t *origin,
+        ee_stream_source_t *item)
+{
+    ee_char_t *chars = item->source.chars;
+    ee_size_t from = item->skip;
+    ee_size_t left = item->keep;
+
+    while (0 < left && EE_STREAM_NO_CHUNK != origin->chunk) {
+        ee_stream_chunk_t *chunk = stream->chunks + origin->chunk;
+        ee_size_t number;
+
+        if (from >= origin->chunk_base + chunk->length) {
+            origin->chunk_base += chunk->length;
+            origin->chunk = chunk->next;
+            continue;
+        }
+
+        number = origin->chunk_base + chunk->length - from;
+        if (number > left) {
+            number = left;
+        }
+
+        if (0 != fseek(stream->spill,
+                chunk->offset + (long)(from - origin->chunk_base), SEEK_SET)
+                || number != fread(chars, sizeof(*chars), number,
+                        stream->spill)) {
+            return EE_FILE_READ_FAILURE;
+        }
+
+        chars += number;
+        from += number;
+        left -= number;
+    }
+
+    if (0 < left) {
+        memcpy(chars, origin->source.chars + (from - origin->chunk_base),
+                left);
+    }
+
+    item->source.length = item->keep;
+
+    return EE_SUCCESS;
+}
+
+static ee_bool_t
+ee_stream_order_handler_s(ee_source_t *source, void *context)
+{
+    ee_stream_t *stream = context;
+
+    stream->order[stream->next_source] = (ee_stream_source_t *)source;
+    stream->next_source += 1;
+
+    return EE_TRUE;
+}
+
+static ee_int_t
+ee_stream_source_next_char_s(ee_stream_reader_t *reader,
+        ee_stream_source_t *item, ee_char_t *ch)
+{
+    ee_int_t status;
+
+    if (item->seen + 1 == item->total_length) {
+        *ch = item->last_char;
+    } else {
+        if (EE_TRUE == item->loaded
+                && item->seen - item->block_offset == item->source.length) {
+            item->current = item->next;
+            item->block_offset += item->source.length;
+            item->loaded = EE_FALSE;
+        }
+
+        if (EE_FALSE == item->loaded) {
+            status = ee_stream_source_load_s(reader, item);
+            if (EE_SUCCESS != status) {
+                return status;
+            }
+        } else if (reader->lru_head != item) {
+            ee_stream_lru_unlink_s(reader, item);
+            ee_stream_lru_link_s(reader, item);
+        }
+
+        *ch = item->source.chars[item->seen - item->block_offset];
+    }
+
+    item->seen += 1;
+
+    return EE_SUCCESS;
+}
+
+static ee_int_t
+ee_stream_source_load_s(ee_stream_reader_t *reader, ee_stream_source_t *item)
+{
+    ee_int_t status;
+    ee_block_t *block;
+
+    status = reader->load(item, &block, reader->context);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    if (item->seen - item->block_offset >= block->length) {
+        return EE_FAILURE;
+    }
+
+    if (NULL != item->source.chars) {
+        ee_stream_lru_unlink_s(reader, item);
+        reader->resident -= item->source.capacity;
+    }
+
+    while (NULL != reader->lru_tail
+            && reader->resident + block->length > reader->window) {
+        ee_stream_lru_evict_s(reader);
+    }
+
+    status = ee_source_reserve(&(item->source), block->length);
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    reader->resident += item->source.capacity;
+    ee_stream_lru_link_s(reader, item);
+
+    memcpy(item->source.chars, block->chars, block->length);
+    item->source.length = block->length;
+    item->loaded = EE_TRUE;
+
+    return EE_SUCCESS;
+}
+
+static void
+ee_stream_lru_link_s(ee_stream_reader_t *reader, ee_stream_source_t *item)
+{
+    item->lru_prev = NULL;
+    item->lru_next = reader->lru_head;
+    if (NULL != reader->lru_head) {
+        reader->lru_head->lru_prev = item;
+    } else {
+        reader->lru_tail = item;
+    }
+
+    reader->lru_head = item;
+}
+
+static void
+ee_stream_lru_unlink_s(ee_stream_reader_t *reader, ee_stream_source_t *item)
+{
+    if (NULL != item->lru_prev) {
+        item->lru_prev->lru_next = item->lru_next;
+    } else {
+        reader->lru_head = item->lru_next;
+    }
+
+    if (NULL != item->lru_next) {
+        item->lru_next->lru_prev = item->lru_prev;
+    } else {
+        reader->lru_tail = item->lru_prev;
+    }
+
+    item->lru_prev = NULL;
+    item->lru_next = NULL;
+}
+
+static void
+ee_stream_lru_evict_s(ee_stream_reader_t *reader)
+{
+    ee_stream_source_t *item = reader->lru_tail;
+
+    ee_stream_lru_unlink_s(reader, item);
+    if (item->seen - item->block_offset == item->source.length) {
+        item->current = item->next;
+        item->block_offset += item->source.length;
+    }
+
+    free(item->source.chars);
+    item->source.chars = NULL;
+    item->source.current_char = NULL;
+    item->source.length = 0;
+    item->loaded = EE_FALSE;
+    reader->resident -= item->source.capacity;
+    item->source.capacity = 0;
+}
@@ -0,0 +1,101 @@
+#ifndef STREAM_H
+#define	STREAM_H
+
+#include <stdio.h>
+
+#include "common.h"
+#include "bits.h"
+#include "io.h"
+#include "source.h"
+
+/* The index of a block in the table the load handler keeps. */
+typedef struct ee_stream_cursor_s {
+    ee_size_t block;
+} ee_stream_cursor_t;
+
+typedef struct ee_stream_source_s {
+    ee_source_t source;
+    ee_size_t total_length;
+    ee_char_t last_char;
+    ee_size_t skip;
+    ee_size_t keep;
+    ee_size_t seen;
+    ee_size_t chunk;
+    ee_size_t last_chunk;
+    ee_size_t chunk_base;
+    ee_size_t block_offset;
+    ee_bool_t loaded;
+    ee_stream_cursor_t current;
+    ee_stream_cursor_t next;
+    struct ee_stream_source_s *lru_prev;
+    struct ee_stream_source_s *lru_next;
+} ee_stream_source_t;
+
+typedef ee_int_t ee_stream_load_handler_t(ee_stream_source_t *item,
+        ee_block_t **block, void *context);
+
+/*
+ * A run of one source's characters in the spill file; next is the index of
+ * the source's following run.
+ */
+typedef struct ee_stream_chunk_s {
+    long offset;
+    ee_size_t length;
+    ee_size_t next;
+} ee_stream_chunk_t;
+
+typedef struct ee_stream_s {
+    ee_file_t *file;
+    ee_char_t *buffer;
+    ee_size_t block_size;
+    ee_size_t window;
+    ee_source_list_t sources;
+    ee_stream_source_t **order;
+    ee_size_t sources_number;
+    ee_size_t next_source;
+    ee_size_t next_offset;
+    ee_size_t resident;
+    FILE *spill;
+    long spill_length;
+    ee_stream_chunk_t *chunks;
+    ee_size_t chunks_number;
+    ee_size_t chunks_capacity;
+} ee_stream_t;
+
+typedef struct ee_stream_reader_s {
+    ee_source_list_t sources;
+    ee_stream_source_t *lru_head;
+    ee_stream_source_t *lru_tail;
+    ee_size_t resident;
+    ee_size_t window;
+    ee_size_t message_length;
+    ee_stream_load_handler_t *load;
+    void *context;
+} ee_stream_reader_t;
+
+ee_stream_source_t *
+ee_stream_source_create(const ee_char_t *prefix, ee_size_t mu);
+void
+ee_stream_source_destroy(ee_stream_source_t *item);
+
+ee_int_t
+ee_stream_init(ee_stream_t *stream, ee_file_t *file, ee_size_t sigma,
+        ee_size_t mu, ee_size_t window);
+void
+ee_stream_deinit(ee_stream_t *stream);
+
+ee_int_t
+ee_stream_next_slice(ee_stream_t *stream, ee_source_list_t *slice);
+
+void
+ee_stream_reader_init(ee_stream_reader_t *reader, ee_size_t mu,
+        ee_size_t window, ee_stream_load_handler_t *load, void *context);
+void
+ee_stream_reader_deinit(ee_stream_reader_t *reader);
+
+ee_int_t
+ee_stream_reader_insert(ee_stream_reader_t *reader, ee_stream_source_t *item);
+ee_int_t
+ee_stream_merge(ee_file_t *file, ee_stream_reader_t *reader);
+
+#endif /* STREAM_H */
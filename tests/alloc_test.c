@@ -0,0 +1,246 @@
+/*
+ * Runs every block of INPUT through the per-block stages of encryption and
+ * decryption twice with the same contexts and fails if the second pass makes
+ * GMP allocate: once the contexts are warm, a block must not allocate.
+ *
+ *   ee_alloc_test SIGMA INPUT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#include "common.h"
+#include "block.h"
+#include "statistics.h"
+#include "numeration.h"
+#include "serializer.h"
+#include "profile.h"
+#include "util.h"
+
+#define EE_ALLOC_TEST_PASSES 2
+
+typedef struct ee_alloc_test_s {
+    ee_size_t sigma;
+    ee_numeration_ctx_t nctx;
+    ee_serializer_ctx_t sctx;
+    ee_block_t block;
+    ee_block_t restored;
+    ee_statistics_t statistics;
+    ee_statistics_t restored_statistics;
+    ee_number_t number;
+    ee_number_t restored_number;
+    ee_subnumber_t subnumber;
+    ee_subnumber_t restored_subnumber;
+    ee_sdata_t statistics_data;
+    ee_sdata_t subset_data;
+    ee_sdata_t subnum_data;
+    mpz_t rho;
+    mpz_t delta;
+} ee_alloc_test_t;
+
+static ee_int_t
+ee_alloc_test_input_read_s(ee_char_t **chars, ee_size_t *length,
+        const char *path);
+static ee_int_t
+ee_alloc_test_block_s(ee_alloc_test_t *test, ee_int_t format);
+
+int
+main(int argc, char **argv)
+{
+    ee_int_t status;
+
+    ee_alloc_test_t test;
+    ee_char_t *chars = NULL;
+    ee_size_t length;
+    uint64_t allocs[EE_ALLOC_TEST_PASSES];
+
+    if (3 != argc) {
+        fprintf(stderr, "usage: %s SIGMA INPUT\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ee_memset(&test, 0, sizeof(test));
+    test.sigma = atoi(argv[1]);
+    status = ee_alloc_test_input_read_s(&chars, &length, argv[2]);
+    if (EE_SUCCESS != status) {
+        fprintf(stderr, "%s: cannot read '%s'\n", argv[0], argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    status = ee_numeration_ctx_init(&(test.nctx), test.sigma);
+    if (EE_SUCCESS != status) {
+        goto nctx_init_error;
+    }
+
+    status = ee_block_init(&(test.block), test.sigma);
+    if (EE_SUCCESS != status) {
+        goto block_init_error;
+    }
+
+    status = ee_block_init(&(test.restored), test.sigma);
+    if (EE_SUCCESS != status) {
+        goto restored_init_error;
+    }
+
+    ee_serializer_ctx_init(&(test.sctx));
+    ee_number_init(&(test.number));
+    ee_number_init(&(test.restored_number));
+    ee_subnumber_init(&(test.subnumber));
+    ee_subnumber_init(&(test.restored_subnumber));
+    mpz_init(test.rho);
+    mpz_init(test.delta);
+
+    ee_profile_enable();
+    for (ee_size_t pass = 0; pass < EE_ALLOC_TEST_PASSES; ++pass) {
+        for (ee_size_t offset = 0; offset < length;
+                offset += test.block.length) {
+            test.block.length = length - offset;
+            if (test.block.length > test.block.size) {
+                test.block.length = test.block.size;
+            }
+
+            memcpy(test.block.chars, chars + offset, test.block.length);
+            status = ee_alloc_test_block_s(&test, EE_STATISTICS_FORMAT_PLAIN);
+            if (EE_SUCCESS == status) {
+                status = ee_alloc_test_block_s(&test,
+                        EE_STATISTICS_FORMAT_COMPACT);
+            }
+
+            if (EE_SUCCESS != status) {
+                fprintf(stderr, "%s: block at %lu is not restored\n", argv[0],
+                        (unsigned long)offset);
+                goto blocks_error;
+            }
+        }
+
+        allocs[pass] = ee_profile_value(EE_PROFILE_MPZ_ALLOCS);
+    }
+
+    printf("sigma %lu: %llu GMP allocations warming up, %llu after\n",
+            (unsigned long)test.sigma, (unsigned long long)allocs[0],
+            (unsigned long long)(allocs[1] - allocs[0]));
+    if (allocs[1] != allocs[0]) {
+        status = EE_FAILURE;
+    }
+
+blocks_error:
+    ee_sdata_clear(&(test.subnum_data));
+    ee_sdata_clear(&(test.subset_data));
+    ee_sdata_clear(&(test.statistics_data));
+    mpz_clear(test.delta);
+    mpz_clear(test.rho);
+    ee_subnumber_deinit(&(test.restored_subnumber));
+    ee_subnumber_deinit(&(test.subnumber));
+    ee_number_deinit(&(test.restored_number));
+    ee_number_deinit(&(test.number));
+    ee_serializer_ctx_deinit(&(test.sctx));
+    ee_block_deinit(&(test.restored));
+restored_init_error:
+    ee_block_deinit(&(test.block));
+block_init_error:
+    ee_numeration_ctx_deinit(&(test.nctx));
+nctx_init_error:
+    free(chars);
+
+    return (EE_SUCCESS == status) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static ee_int_t
+ee_alloc_test_input_read_s(ee_char_t **chars, ee_size_t *length,
+        const char *path)
+{
+    ee_int_t status = EE_SUCCESS;
+    FILE *file;
+    long size;
+
+    file = fopen(path, "rb");
+    if (NULL == file) {
+        return EE_FAILURE;
+    }
+
+    if (0 != fseek(file, 0, SEEK_END)) {
+        status = EE_FAILURE;
+        goto end;
+    }
+
+    size = ftell(file);
+    if (0 > size || 0 != fseek(file, 0, SEEK_SET)) {
+        status = EE_FAILURE;
+        goto end;
+    }
+
+    *length = size;
+    *chars = malloc(*length + 1);
+    if (NULL == *chars) {
+        status = EE_ALLOC_FAILURE;
+        goto end;
+    }
+
+    if (*length != fread(*chars, 1, *length, file)) {
+        free(*chars);
+        *chars = NULL;
+        status = EE_FAILURE;
+    }
+
+end:
+    fclose(file);
+    return status;
+}
+
+/*
+ * The same stages as ee_bench_block_s() in bench/ee_bench.c, without the
+ * keystream, which does not touch GMP.
+ */
+static ee_int_t
+ee_alloc_test_block_s(ee_alloc_test_t *test, ee_int_t format)
+{
+    ee_int_t status;
+
+    ee_block_t *block = &(test->block);
+    ee_block_t *restored = &(test->restored);
+    ee_subnumber_t *subnumber = &(test->restored_subnumber);
+
+    ee_statistics_gather(&(test->statistics), block);
+    ee_number_eval(&(test->nctx), &(test->number), block, &(test->statistics));
+    ee_subnumber_eval(&(test->nctx), &(test->subnumber), &(test->number));
+    status = ee_mpz_serialize(&(test->subnum_data), test->subnumber.subnum,
+            test->subnumber.subnum_bit_length);
+    if (EE_SUCCESS == status) {
+        status = ee_statistics_serialize(&(test->sctx),
+                &(test->statistics_data), &(test->statistics), test->sigma,
+                format);
+    }
+
+    if (EE_SUCCESS == status) {
+        status = ee_subset_serialize(&(test->subset_data),
+                test->subnumber.subset, test->sigma);
+    }
+
+    if (EE_SUCCESS != status) {
+        return status;
+    }
+
+    ee_statistics_deserialize(&(test->sctx), &(test->restored_statistics),
+            &(test->statistics_data), test->sigma);
+    ee_subset_deserialize(&(subnumber->subset), &(test->subset_data));
+    ee_block_generate(restored, &(test->restored_statistics));
+    ee_eval_rho_delta(&(test->nctx), test->rho, test->delta, restored,
+            &(test->restored_statistics));
+    ee_eval_subnum_bit_length(&(subnumber->subnum_bit_length), test->delta,
+            subnumber->subset);
+    ee_mpz_deserialize(subnumber->subnum, subnumber->subnum_bit_length,
+            &(test->subnum_data));
+    ee_number_restore(&(test->nctx), &(test->restored_number), test->delta,
+            subnumber);
+    ee_block_restore(&(test->nctx), restored, &(test->restored_statistics),
+            test->rho, &(test->restored_number));
+
+    if (restored->length != block->length
+            || 0 != memcmp(restored->chars, block->chars, block->length)) {
+        return EE_FAILURE;
+    }
+
+    return EE_SUCCESS;
+}
@@ -0,0 +1,49 @@
+# Encrypts INPUT with the given sigma, mu and statistics format, compares the
+# public and private parts byte for byte with GOLDEN.pub and GOLDEN.pri, then
+# decrypts them and compares the result with INPUT.
+#
+#   cmake -DEE=... -DINPUT=... -DGOLDEN=... -DWORK=... -DSIGMA=... -DMU=...
+#         -DFORMAT=plain|compact [-DUPDATE=ON] -P roundtrip.cmake
+#
+# UPDATE=ON writes the produced files over the golden ones instead.
+
+set(KEY "ee-test-key")
+
+file(MAKE_DIRECTORY ${WORK})
+set(ENCRYPTED ${WORK}/encrypted)
+set(DECRYPTED ${WORK}/decrypted)
+
+set(ENCRYPT_ARGS -m encrypt -s ${SIGMA} -u ${MU} -k ${KEY} -p)
+if(FORMAT STREQUAL "compact")
+	list(APPEND ENCRYPT_ARGS -c)
+endif()
+
+execute_process(COMMAND ${EE} ${ENCRYPT_ARGS} -o ${ENCRYPTED} ${INPUT}
+	RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "encryption failed: ${result}")
+endif()
+
+foreach(PART pub pri)
+	if(UPDATE)
+		configure_file(${ENCRYPTED}.${PART} ${GOLDEN}.${PART} COPYONLY)
+	else()
+		execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files
+			${ENCRYPTED}.${PART} ${GOLDEN}.${PART} RESULT_VARIABLE result)
+		if(NOT result EQUAL 0)
+			message(FATAL_ERROR "${ENCRYPTED}.${PART} differs from ${GOLDEN}.${PART}")
+		endif()
+	endif()
+endforeach()
+
+execute_process(COMMAND ${EE} -m decrypt -s ${SIGMA} -u ${MU} -k ${KEY} -p
+	-o ${DECRYPTED} ${ENCRYPTED} RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "decryption failed: ${result}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${DECRYPTED} ${INPUT}
+	RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "${DECRYPTED} differs from ${INPUT}")
+endif()